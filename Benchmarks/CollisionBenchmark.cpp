@@ -0,0 +1,523 @@
+////////////////////////////////////////////////////////////////////////////////
+//  CollisionBenchmark.cpp
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Runs synthetic scenes through GameWorld and CollisionManager and reports
+//  the time spent in each phase, as JSON or CSV. Builds without GL, see the
+//  Makefile next to this file.
+//
+//  Usage: CollisionBenchmark [options]
+//      --scene NAME        uniform, piles, mixed, maze, scrolling or all
+//      --count N           Number of entities, 0 picks per scene
+//      --walls N           Number of maze walls, 0 runs 10, 500 and 5000
+//      --frames N          Frames measured per run
+//      --warmup N          Frames run before measuring
+//      --broadphase NAME   hash, sap, tree or all
+//      --threads N         Narrowphase threads
+//      --sleep on|off      Sleeping bodies
+//      --format json|csv
+//      --out FILE          Write the results here instead of stdout
+//      --seed N
+//      --help              Prints this
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "GameWorld.h"
+#include "DynamicEntity2D.h"
+#include "Stopwatch.h"
+#include "JobSystem.h"
+
+using namespace Furiosity;
+using std::string;
+
+////////////////////////////////////////////////////////////////////////////////
+// Settings from the command line
+////////////////////////////////////////////////////////////////////////////////
+struct Settings
+{
+    string  scene;
+    int     count;
+    int     walls;
+    int     frames;
+    int     warmup;
+    string  broadphase;
+    int     threads;
+    bool    sleep;
+    string  format;
+    string  out;
+    int     seed;
+
+    Settings() :
+        scene("all"),
+        count(0),
+        walls(0),
+        frames(300),
+        warmup(30),
+        broadphase("all"),
+        threads(1),
+        sleep(true),
+        format("json"),
+        seed(1) {}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// One scene with one broadphase, the times are averages per frame in ms
+////////////////////////////////////////////////////////////////////////////////
+struct Result
+{
+    string  scene;
+    string  broadphase;
+    int     entities;
+    int     walls;
+    int     frames;
+    double  contacts;
+    int     peakContacts;
+    int     droppedContacts;
+    double  broadphaseMs;
+    double  narrowphaseMs;
+    double  wallsMs;
+    double  resolveMs;
+    double  otherMs;
+    double  stepMs;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// A world that scrolls, dropping what falls off the left side and spawning
+// new entities on the right
+////////////////////////////////////////////////////////////////////////////////
+class BenchmarkWorld : public GameWorld
+{
+public:
+    /// Half the size of the arena
+    float   halfSize;
+
+    /// Scroll speed, zero for a world that stays put
+    float   scroll;
+
+    BenchmarkWorld(float halfSize) : halfSize(halfSize), scroll(0.0f)
+    {
+        manageCollisions = true;
+    }
+
+    /// Adds a moving disk
+    void AddDisk(const Vector2& position, float radius, const Vector2& velocity)
+    {
+        DynamicEntity2D* e = new DynamicEntity2D(position, radius);
+        e->SetLinearDaming(1.0f);
+        e->SetVelocity(velocity);
+        AddEntity(e);
+    }
+
+    /// Adds the four walls around the arena
+    void AddBounds()
+    {
+        Vector2 a(-halfSize, -halfSize);
+        Vector2 b( halfSize, -halfSize);
+        Vector2 c( halfSize,  halfSize);
+        Vector2 d(-halfSize,  halfSize);
+        AddWall(LineSegment(a, b));
+        AddWall(LineSegment(b, c));
+        AddWall(LineSegment(c, d));
+        AddWall(LineSegment(d, a));
+    }
+
+    virtual void Update(float dt)
+    {
+        if(scroll > 0.0f)
+        {
+            for(auto e : entities)
+            {
+                if(e->Position().x < -halfSize)
+                {
+                    RemoveEntity(e);
+                    AddDisk(Vector2(RandInRange(halfSize * 0.9f, halfSize),
+                                    RandInRange(-halfSize, halfSize)),
+                            RandInRange(1.0f, 3.0f),
+                            Vector2(-scroll, RandInRange(-10.0f, 10.0f)));
+                }
+            }
+        }
+
+        GameWorld::Update(dt);
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Scenes
+////////////////////////////////////////////////////////////////////////////////
+
+// Disks of the same size spread all over
+static void BuildUniform(BenchmarkWorld& world, int count)
+{
+    world.AddBounds();
+    float h = world.halfSize;
+    for(int i = 0; i < count; i++)
+        world.AddDisk(Vector2(RandInRange(-h, h), RandInRange(-h, h)),
+                      2.0f,
+                      Vector2(RandInRange(-20.0f, 20.0f), RandInRange(-20.0f, 20.0f)));
+}
+
+// Tight clusters that push apart and settle
+static void BuildPiles(BenchmarkWorld& world, int count)
+{
+    world.AddBounds();
+    float h = world.halfSize;
+    int piles = count / 200 + 1;
+    for(int i = 0; i < count; i++)
+    {
+        float cx = -h * 0.6f + (1.2f * h * (i % piles)) / piles;
+        float spread = 2.0f * sqrtf(200.0f);
+        world.AddDisk(Vector2(cx + RandInRange(-spread, spread), RandInRange(-spread, spread)),
+                      2.0f,
+                      Vector2(RandInRange(-1.0f, 1.0f), RandInRange(-1.0f, 1.0f)));
+    }
+}
+
+// Mostly small disks with a few big ones
+static void BuildMixed(BenchmarkWorld& world, int count)
+{
+    world.AddBounds();
+    float h = world.halfSize;
+    for(int i = 0; i < count; i++)
+    {
+        float r = RandInRange(0.0f, 1.0f);
+        float radius = 0.5f + 20.0f * r * r * r * r;
+        world.AddDisk(Vector2(RandInRange(-h, h), RandInRange(-h, h)),
+                      radius,
+                      Vector2(RandInRange(-20.0f, 20.0f), RandInRange(-20.0f, 20.0f)));
+    }
+}
+
+// Random walls along a grid with disks running around
+static void BuildMaze(BenchmarkWorld& world, int count, int walls)
+{
+    world.AddBounds();
+    float h = world.halfSize;
+    int cells = (int)sqrtf(walls) + 1;
+    float cell = 2.0f * h / cells;
+    for(int i = 4; i < walls; i++)
+    {
+        Vector2 a(-h + cell * RandInRange(0, cells), -h + cell * RandInRange(0, cells));
+        Vector2 b = RandInRange(0, 2) ? a + Vector2(cell, 0) : a + Vector2(0, cell);
+        world.AddWall(LineSegment(a, b));
+    }
+
+    for(int i = 0; i < count; i++)
+        world.AddDisk(Vector2(RandInRange(-h, h), RandInRange(-h, h)),
+                      cell * 0.1f,
+                      Vector2(RandInRange(-20.0f, 20.0f), RandInRange(-20.0f, 20.0f)));
+}
+
+// Everything drifts left and gets replaced on the right
+static void BuildScrolling(BenchmarkWorld& world, int count)
+{
+    float h = world.halfSize;
+    world.scroll = 40.0f;
+    for(int i = 0; i < count; i++)
+        world.AddDisk(Vector2(RandInRange(-h, h), RandInRange(-h, h)),
+                      RandInRange(1.0f, 3.0f),
+                      Vector2(-world.scroll, RandInRange(-10.0f, 10.0f)));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Run
+////////////////////////////////////////////////////////////////////////////////
+static Result Run(const Settings& settings,
+                  const string& scene,
+                  int count,
+                  int walls,
+                  const string& broadphase)
+{
+    srand(settings.seed);
+
+    // Keep about the same density for all counts
+    BenchmarkWorld world(sqrtf((float)count) * 6.0f);
+
+    CollisionManager* collisions = world.GetCollisionManager();
+    collisions->SetProfiling(true);
+    collisions->SetJobSystem(settings.threads > 1 ? &gJobSystem : 0);
+    collisions->SetSleeping(settings.sleep);
+    if(broadphase == "sap")
+        collisions->SetBroadphase(BROADPHASE_SWEEP_AND_PRUNE);
+    else if(broadphase == "tree")
+        collisions->SetBroadphase(BROADPHASE_DYNAMIC_TREE);
+    else
+        collisions->SetBroadphase(BROADPHASE_SPATIAL_HASH);
+
+    if(scene == "uniform")
+        BuildUniform(world, count);
+    else if(scene == "piles")
+        BuildPiles(world, count);
+    else if(scene == "mixed")
+        BuildMixed(world, count);
+    else if(scene == "maze")
+        BuildMaze(world, count, walls);
+    else
+        BuildScrolling(world, count);
+
+    const float dt = 1.0f / 60.0f;
+    for(int i = 0; i < settings.warmup; i++)
+        world.Update(dt);
+
+    Result result;
+    result.scene            = scene;
+    result.broadphase       = broadphase;
+    result.entities         = count;
+    result.walls            = (int)world.walls.size();
+    result.frames           = settings.frames;
+    result.contacts         = 0.0;
+    result.broadphaseMs     = 0.0;
+    result.narrowphaseMs    = 0.0;
+    result.wallsMs          = 0.0;
+    result.resolveMs        = 0.0;
+    result.stepMs           = 0.0;
+
+    collisions->ResetContactStats();
+
+    Stopwatch watch;
+    for(int i = 0; i < settings.frames; i++)
+    {
+        watch.Start();
+        world.Update(dt);
+        result.stepMs += watch.Stop();
+
+        const CollisionTimings& t = collisions->GetTimings();
+        result.broadphaseMs     += t.Broadphase;
+        result.narrowphaseMs    += t.Narrowphase;
+        result.wallsMs          += t.Walls;
+        result.resolveMs        += t.Resolve;
+        result.contacts         += collisions->GetSolverStats().Contacts;
+    }
+
+    // Seconds in total to milliseconds per frame
+    double scale = 1000.0 / settings.frames;
+    result.broadphaseMs     *= scale;
+    result.narrowphaseMs    *= scale;
+    result.wallsMs          *= scale;
+    result.resolveMs        *= scale;
+    result.stepMs           *= scale;
+    result.contacts         /= settings.frames;
+    result.peakContacts     = collisions->ContactHighWaterMark();
+    result.droppedContacts  = collisions->DroppedContactCount();
+    result.otherMs          = result.stepMs -
+                              result.broadphaseMs -
+                              result.narrowphaseMs -
+                              result.wallsMs -
+                              result.resolveMs;
+
+    world.Clear();
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Output
+////////////////////////////////////////////////////////////////////////////////
+static void WriteJson(FILE* file, const Settings& settings, const std::vector<Result>& results)
+{
+    fprintf(file, "{\n");
+    fprintf(file, "  \"benchmark\": \"collisions\",\n");
+    fprintf(file, "  \"threads\": %d,\n", settings.threads);
+    fprintf(file, "  \"sleep\": %s,\n", settings.sleep ? "true" : "false");
+    fprintf(file, "  \"seed\": %d,\n", settings.seed);
+    fprintf(file, "  \"results\": [\n");
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        const Result& r = results[i];
+        fprintf(file,
+                "    {\"scene\": \"%s\", \"broadphase\": \"%s\", \"entities\": %d, "
+                "\"walls\": %d, \"frames\": %d, \"contacts\": %.1f, "
+                "\"peak_contacts\": %d, \"dropped_contacts\": %d, "
+                "\"ms\": {\"broadphase\": %.4f, \"narrowphase\": %.4f, \"walls\": %.4f, "
+                "\"resolve\": %.4f, \"other\": %.4f, \"step\": %.4f}}%s\n",
+                r.scene.c_str(), r.broadphase.c_str(), r.entities,
+                r.walls, r.frames, r.contacts,
+                r.peakContacts, r.droppedContacts,
+                r.broadphaseMs, r.narrowphaseMs, r.wallsMs,
+                r.resolveMs, r.otherMs, r.stepMs,
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n");
+    fprintf(file, "}\n");
+}
+
+static void WriteCsv(FILE* file, const std::vector<Result>& results)
+{
+    fprintf(file, "scene,broadphase,entities,walls,frames,contacts,peak_contacts,dropped_contacts,"
+                  "broadphase_ms,narrowphase_ms,walls_ms,resolve_ms,other_ms,step_ms\n");
+    for(const Result& r : results)
+    {
+        fprintf(file, "%s,%s,%d,%d,%d,%.1f,%d,%d,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n",
+                r.scene.c_str(), r.broadphase.c_str(), r.entities,
+                r.walls, r.frames, r.contacts,
+                r.peakContacts, r.droppedContacts,
+                r.broadphaseMs, r.narrowphaseMs, r.wallsMs,
+                r.resolveMs, r.otherMs, r.stepMs);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Usage, same as at the top of this file
+////////////////////////////////////////////////////////////////////////////////
+static void PrintUsage(FILE* file)
+{
+    fprintf(file,
+            "Usage: CollisionBenchmark [options]\n"
+            "    --scene NAME        uniform, piles, mixed, maze, scrolling or all\n"
+            "    --count N           Number of entities, 0 picks per scene\n"
+            "    --walls N           Number of maze walls, 0 runs 10, 500 and 5000\n"
+            "    --frames N          Frames measured per run\n"
+            "    --warmup N          Frames run before measuring\n"
+            "    --broadphase NAME   hash, sap, tree or all\n"
+            "    --threads N         Narrowphase threads\n"
+            "    --sleep on|off      Sleeping bodies\n"
+            "    --format json|csv\n"
+            "    --out FILE          Write the results here instead of stdout\n"
+            "    --seed N\n"
+            "    --help              Prints this\n");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Main
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+    Settings settings;
+    for(int i = 1; i < argc; i += 2)
+    {
+        string key = argv[i];
+        if(key == "--help")
+        {
+            PrintUsage(stdout);
+            return 0;
+        }
+
+        // All the other options take a value
+        if(i + 1 >= argc)
+        {
+            fprintf(stderr, "Unknown option %s\n", key.c_str());
+            PrintUsage(stderr);
+            return 1;
+        }
+        const char* val = argv[i + 1];
+
+        if(key == "--scene")            settings.scene = val;
+        else if(key == "--count")       settings.count = atoi(val);
+        else if(key == "--walls")       settings.walls = atoi(val);
+        else if(key == "--frames")      settings.frames = atoi(val);
+        else if(key == "--warmup")      settings.warmup = atoi(val);
+        else if(key == "--broadphase")  settings.broadphase = val;
+        else if(key == "--threads")     settings.threads = atoi(val);
+        else if(key == "--sleep")       settings.sleep = strcmp(val, "off") != 0;
+        else if(key == "--format")      settings.format = val;
+        else if(key == "--out")         settings.out = val;
+        else if(key == "--seed")        settings.seed = atoi(val);
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", key.c_str());
+            PrintUsage(stderr);
+            return 1;
+        }
+    }
+
+    if(settings.frames <= 0)
+    {
+        fprintf(stderr, "Need at least one frame\n");
+        return 1;
+    }
+
+    if(settings.threads > 1)
+        gJobSystem.Initialize(settings.threads);
+
+    std::vector<string> broadphases;
+    if(settings.broadphase == "all")
+        broadphases = { "hash", "sap", "tree" };
+    else
+        broadphases.push_back(settings.broadphase);
+
+    // Scene, default count and walls, zero walls means the bounds only
+    struct Case { string scene; int count; int walls; };
+    std::vector<Case> cases;
+    //
+    auto add = [&](const string& scene, int count, int walls)
+    {
+        if(settings.scene != "all" && settings.scene != scene)
+            return;
+        cases.push_back({ scene,
+                          settings.count > 0 ? settings.count : count,
+                          walls });
+    };
+    //
+    add("uniform",   1000, 0);
+    add("uniform",   4000, 0);
+    add("piles",     2000, 0);
+    add("mixed",     2000, 0);
+    if(settings.walls > 0)
+        add("maze",  500, settings.walls);
+    else
+    {
+        add("maze",  500, 10);
+        add("maze",  500, 500);
+        add("maze",  500, 5000);
+    }
+    add("scrolling", 2000, 0);
+
+    if(cases.empty())
+    {
+        fprintf(stderr, "Unknown scene %s\n", settings.scene.c_str());
+        return 1;
+    }
+
+    // With a count given the same case can come up twice
+    if(settings.count > 0)
+    {
+        std::vector<Case> unique;
+        for(const Case& c : cases)
+        {
+            bool seen = false;
+            for(const Case& u : unique)
+                seen |= u.scene == c.scene && u.walls == c.walls;
+            if(!seen)
+                unique.push_back(c);
+        }
+        cases.swap(unique);
+    }
+
+    std::vector<Result> results;
+    for(const Case& c : cases)
+    {
+        for(const string& broadphase : broadphases)
+        {
+            fprintf(stderr, "%s %d entities %d walls, %s\n",
+                    c.scene.c_str(), c.count, c.walls, broadphase.c_str());
+            results.push_back(Run(settings, c.scene, c.count, c.walls, broadphase));
+        }
+    }
+
+    FILE* file = stdout;
+    if(!settings.out.empty())
+    {
+        file = fopen(settings.out.c_str(), "w");
+        if(!file)
+        {
+            fprintf(stderr, "Can't write to %s\n", settings.out.c_str());
+            return 1;
+        }
+    }
+
+    if(settings.format == "csv")
+        WriteCsv(file, results);
+    else
+        WriteJson(file, settings, results);
+
+    if(file != stdout)
+        fclose(file);
+
+    return 0;
+}
@@ -419,7 +419,7 @@ Vector2 SteeringBehavior::FollowPath()
 // Given a vector of CObstacles, this method returns a steering force
 // that will prevent the agent colliding with the closest obstacle
 ////////////////////////////////////////////////////////////////////////////////
-Vector2 SteeringBehavior::ObstacleAvoidance(const list<Furiosity::Entity2D*> &entites)
+Vector2 SteeringBehavior::ObstacleAvoidance(const std::vector<Entity2D*>& entites)
 {
     float MinDetectionBoxLength = 120.0f;
     
@@ -448,7 +448,7 @@ Vector2 SteeringBehavior::ObstacleAvoidance(const list<Furiosity::Entity2D*> &en
     //
     Matrix33 toLocal = toWorld.Inverse();
     
-    std::list<Entity2D*>::const_iterator curOb = entites.begin();
+    std::vector<Entity2D*>::const_iterator curOb = entites.begin();
     //
     while(curOb != entites.end())
     {
@@ -145,7 +145,7 @@ namespace Furiosity
         
         // This returns a steering force which will attempt to keep the agent 
         // away from any obstacles it may encounter
-        Vector2 ObstacleAvoidance(const list<Entity2D*>& entites);
+        Vector2 ObstacleAvoidance(const std::vector<Entity2D*>& entites);
         
         // Used to avoid staling - might use a tiny bit of wander
         // but this is cheaper
@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////////
+//  AABB.h
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Vector2.h"
+
+namespace Furiosity
+{
+    ///
+    /// An axis aligned bounding box in 2D
+    ///
+    class AABB
+    {
+    public:
+        /// Lower left corner
+        Vector2 Min;
+
+        /// Upper right corner
+        Vector2 Max;
+
+    public:
+        /// Empty box at the origin
+        AABB() {}
+
+        /// Box from corners
+        AABB(const Vector2& min, const Vector2& max) : Min(min), Max(max) {}
+
+        /// Box around a disk
+        static AABB FromDisk(const Vector2& center, float radius)
+        {
+            return AABB(Vector2(center.x - radius, center.y - radius),
+                        Vector2(center.x + radius, center.y + radius));
+        }
+
+        /// Box around a line segment
+        static AABB FromSegment(const Vector2& a, const Vector2& b)
+        {
+            return AABB(Vector2(a.x < b.x ? a.x : b.x, a.y < b.y ? a.y : b.y),
+                        Vector2(a.x > b.x ? a.x : b.x, a.y > b.y ? a.y : b.y));
+        }
+
+        /// Smallest box containing both boxes
+        static AABB Merge(const AABB& a, const AABB& b)
+        {
+            return AABB(Vector2(a.Min.x < b.Min.x ? a.Min.x : b.Min.x,
+                                a.Min.y < b.Min.y ? a.Min.y : b.Min.y),
+                        Vector2(a.Max.x > b.Max.x ? a.Max.x : b.Max.x,
+                                a.Max.y > b.Max.y ? a.Max.y : b.Max.y));
+        }
+
+        /// Center of the box
+        Vector2 Center() const  { return (Min + Max) * 0.5f; }
+
+        /// Half the size of the box
+        Vector2 Extents() const { return (Max - Min) * 0.5f; }
+
+        /// Perimeter of the box, used as cost when building trees
+        float Perimeter() const { return 2.0f * ((Max.x - Min.x) + (Max.y - Min.y)); }
+
+        /// Grows the box on all sides
+        AABB Fattened(float margin) const
+        {
+            return AABB(Vector2(Min.x - margin, Min.y - margin),
+                        Vector2(Max.x + margin, Max.y + margin));
+        }
+
+        /// Checks if two boxes overlap
+        bool Overlaps(const AABB& other) const
+        {
+            return  Min.x <= other.Max.x && other.Min.x <= Max.x &&
+                    Min.y <= other.Max.y && other.Min.y <= Max.y;
+        }
+
+        /// Checks if the other box is completely inside this one
+        bool Contains(const AABB& other) const
+        {
+            return  Min.x <= other.Min.x && Min.y <= other.Min.y &&
+                    other.Max.x <= Max.x && other.Max.y <= Max.y;
+        }
+
+        /// Checks if a point is inside the box
+        bool Contains(const Vector2& point) const
+        {
+            return  Min.x <= point.x && point.x <= Max.x &&
+                    Min.y <= point.y && point.y <= Max.y;
+        }
+
+        /// Slab test of the segment from + (to - from) * t for t in [0, maxT]
+        ///
+        /// @return True if the segment hits the box
+        bool Raycast(const Vector2& from, const Vector2& to, float maxT = 1.0f) const
+        {
+            float tmin = 0.0f;
+            float tmax = maxT;
+            Vector2 d = to - from;
+            //
+            for(int i = 0; i < 2; i++)
+            {
+                if(d[i] == 0.0f)
+                {
+                    // Parallel, so must be inside the slab
+                    if(from[i] < Min[i] || from[i] > Max[i])
+                        return false;
+                }
+                else
+                {
+                    float inv = 1.0f / d[i];
+                    float t0  = (Min[i] - from[i]) * inv;
+                    float t1  = (Max[i] - from[i]) * inv;
+                    if(t0 > t1) { float t = t0; t0 = t1; t1 = t; }
+                    if(t0 > tmin) tmin = t0;
+                    if(t1 < tmax) tmax = t1;
+                    if(tmin > tmax)
+                        return false;
+                }
+            }
+            return true;
+        }
+    };
+}
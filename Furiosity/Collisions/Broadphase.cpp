@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Broadphase.cpp
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Broadphase.h"
+
+using namespace Furiosity;
+
+////////////////////////////////////////////////////////////////////////////////
+// Update
+////////////////////////////////////////////////////////////////////////////////
+void Broadphase::Update(const std::vector<Entity2D*>& entities)
+{
+    bodies.clear();
+    skipped.clear();
+
+    if(!BeginUpdate(entities))
+        return;
+
+    stamp++;
+
+    for(Entity2D* e : entities)
+    {
+        // If no collision or nothing collides with its layer, then skip
+        // this entitiy
+        if(e->BoundingRadius() <= 0 ||
+           !(activeLayers & (1u << e->CollisionLayer())))
+        {
+            skipped.push_back(e);
+            continue;
+        }
+
+        int proxy;
+        auto itr = lookup.find(e);
+        if(itr == lookup.end())
+        {
+            Entry entry;
+            entry.proxy     = proxy = CreateProxy(e);
+            entry.stamp     = stamp;
+            entry.position  = e->Position();
+            lookup[e]       = entry;
+        }
+        else
+        {
+            Entry& entry = itr->second;
+            proxy = entry.proxy;
+            entry.stamp = stamp;
+            
+            // Sleeping bodies stay where they are, unless they were moved
+            // by hand
+            if(!e->IsSleeping() || entry.position != e->Position())
+            {
+                MoveProxy(proxy);
+                entry.position = e->Position();
+            }
+        }
+
+        // Keep track of where the body is
+        if(proxy >= (int)slots.size())
+            slots.resize(proxy + 1, -1);
+        slots[proxy] = (int)bodies.size();
+        bodies.push_back(e);
+    }
+
+    // Drop entities that were not in the list
+    for(auto itr = lookup.begin(); itr != lookup.end();)
+    {
+        if(itr->second.stamp != stamp)
+        {
+            DestroyProxy(itr->second.proxy);
+            itr = lookup.erase(itr);
+        }
+        else
+            ++itr;
+    }
+
+    EndUpdate();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Clear
+////////////////////////////////////////////////////////////////////////////////
+void Broadphase::Clear()
+{
+    lookup.clear();
+    bodies.clear();
+    slots.clear();
+    skipped.clear();
+    ClearProxies();
+}
+
+// end
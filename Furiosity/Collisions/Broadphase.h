@@ -0,0 +1,152 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Broadphase.h
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+
+// Local
+#include "Entity2D.h"
+#include "AABB.h"
+
+namespace Furiosity
+{
+    /// A pair of entities that might be touching
+    struct BroadphasePair
+    {
+        Entity2D* First;
+        Entity2D* Second;
+
+        /// Indices of the entities in the broadphase bodies
+        int       FirstIndex;
+        int       SecondIndex;
+    };
+
+    /// The broadphase implementations the collision manager can use
+    enum BroadphaseType
+    {
+        BROADPHASE_SPATIAL_HASH,
+        BROADPHASE_SWEEP_AND_PRUNE,
+        BROADPHASE_DYNAMIC_TREE
+    };
+
+    /// Tight bounds of an entity, as the broadphase sees it
+    inline AABB EntityBounds(const Entity2D* entity)
+    {
+        return AABB::FromDisk(entity->Position(), entity->BoundingRadius());
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Broadphase
+    // Base class for all persistent broadphase structures. It keeps track of
+    // which entities it has seen, so that implementations only need to handle
+    // the creation, movement and destruction of their proxies. Every entity
+    // with a bounding radius gets exactly one proxy.
+    ////////////////////////////////////////////////////////////////////////////////
+    class Broadphase
+    {
+    protected:
+        /// What the broadphase knows about an entity
+        struct Entry
+        {
+            /// Proxy handle given out by the implementation
+            int     proxy;
+
+            /// Frame stamp of the last update, used to detect removed entities
+            uint    stamp;
+
+            /// Where the entity was when its proxy was last placed
+            Vector2 position;
+        };
+
+        /// Maps entities to proxies
+        std::unordered_map<Entity2D*, Entry>    lookup;
+
+        /// Current frame stamp
+        uint                                    stamp;
+
+        /// All the entities from the last update, in the order they came in
+        std::vector<Entity2D*>                  bodies;
+
+        /// Maps a proxy handle to an index in bodies
+        std::vector<int>                        slots;
+
+        /// Entities from the last update that didn't get a proxy, because
+        /// they have no radius or are on an inactive layer
+        std::vector<Entity2D*>                  skipped;
+
+        /// Bit mask of the collision layers that get proxies
+        uint                                    activeLayers;
+
+    public:
+        /// Ctor
+        Broadphase() : stamp(0), activeLayers(0xffffffff) {}
+
+        /// Virtual dtor
+        virtual ~Broadphase() {}
+
+        /// Brings the broadphase up to date with the entities. New entities are
+        /// inserted, existing ones are moved and entities that are not in the
+        /// list anymore are dropped.
+        void Update(const std::vector<Entity2D*>& entities);
+
+        /// Removes all entities
+        void Clear();
+
+        /// Entities on layers that are not in the mask are left out, as if
+        /// they were not in the list at all
+        void SetActiveLayers(uint layers) { activeLayers = layers; }
+
+        /// All the entities with a proxy, as of the last update. Pairs refer
+        /// to these by index, which allows for mirroring data per body.
+        const std::vector<Entity2D*>& Bodies() const { return bodies; }
+
+        /// All the entities without a proxy, as of the last update
+        const std::vector<Entity2D*>& Skipped() const { return skipped; }
+
+        /// Appends all the pairs that might be touching. Each pair is reported
+        /// only once. The buffer is not cleared, so it can be reused.
+        virtual void CollectPairs(std::vector<BroadphasePair>& pairs) const = 0;
+
+        /// Appends all the entities with bounds overlapping the box, as of the
+        /// last update. The buffer is not cleared, so it can be reused.
+        virtual void Query(const AABB& box, std::vector<Entity2D*>& result) const = 0;
+
+#ifdef DEBUG
+        virtual void DebugRender() {}
+#endif
+
+    protected:
+        /// Called before the entities are synced, return false to skip the update
+        virtual bool BeginUpdate(const std::vector<Entity2D*>& /*entities*/) { return true; }
+
+        /// Called after all the entities have been synced
+        virtual void EndUpdate() {}
+
+        /// Creates a proxy for a new entity and returns a handle to it
+        virtual int  CreateProxy(Entity2D* entity) = 0;
+
+        /// Called every update for an entity that is still around
+        virtual void MoveProxy(int proxy) = 0;
+
+        /// Called for an entity that is gone. Don't touch the entity itself
+        /// in here as it might have been deleted already.
+        virtual void DestroyProxy(int proxy) = 0;
+
+        /// Drops all proxies
+        virtual void ClearProxies() = 0;
+
+        /// Adds a pair of proxies to the result
+        void ReportPair(std::vector<BroadphasePair>& pairs, int proxy0, int proxy1) const
+        {
+            int i = slots[proxy0];
+            int j = slots[proxy1];
+            BroadphasePair pair = { bodies[i], bodies[j], i, j };
+            pairs.push_back(pair);
+        }
+    };
+}
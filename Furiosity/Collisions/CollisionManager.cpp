@@ -10,156 +10,147 @@
 #include "CollisionMethods.h"
 #include "GameWorld.h"
 #include "DebugDraw2D.h"
+#include "SpatialHash.h"
+#include "SweepAndPrune.h"
+#include "DynamicTree.h"
+#include "DynamicEntity2D.h"
+#include "Stopwatch.h"
 
 using namespace Furiosity;
 
+////////////////////////////////////////////////////////////////////////////////
+// Ctor
+////////////////////////////////////////////////////////////////////////////////
+CollisionManager::CollisionManager(GameWorld* gameWorld, int contactCapacity)
+:   contacts(contactCapacity),
+    broadphase(0),
+    jobs(0),
+    minParallelPairs(256),
+    sweptBodies(0),
+    sleepingEnabled(false),
+    sleepVelocity(0.5f),
+    timeToSleep(0.5f),
+    sleepingBodies(0),
+    sweepSlop(0.1f),
+    frame(0),
+    contactLifetime(2),
+    warmStarting(true),
+    restitutionThreshold(1.0f),
+    restitution(1.0f),
+    velocityIterations(8),
+    positionIterations(3),
+    velocityTolerance(0.001f),
+    positionTolerance(0.001f),
+    profiling(false),
+    gameWorld(gameWorld)
+{
+    for(int i = 0; i < MaxCollisionLayers; i++)
+        layerMasks[i] = 0xffffffff;
+    
+    SetBroadphase(BROADPHASE_SPATIAL_HASH);
+}
 
 ////////////////////////////////////////////////////////////////////////////////
-//
-//                                  Grid
-//
+// Dtor
 ////////////////////////////////////////////////////////////////////////////////
-Grid::Grid(const std::list<Entity2D*>& entities)
+CollisionManager::~CollisionManager()
 {
-    // Set initial values
-    min.x = FLT_MAX;
-    min.y = FLT_MAX;
-    max.x = FLT_MIN;
-    max.y = FLT_MIN;
-    float maxsize = FLT_MIN;
-    
-    // Go over all entities for find the bounds of the world
-    for(Entity2D* e : entities)
-    {
-        // Get the size
-        float r = e->BoundingRadius();
-        
-        // If no collision, then skip this entitiy
-        if(r <= 0)
-            continue;
-        
-        // Track max size
-        if(2 * r > maxsize)
-            maxsize = 2 * r;
-        
-        // Build the grid size
-        Vector2 pos = e->Position();
-        if(pos.x + r > max.x)
-            max.x = pos.x + r;
-        if(pos.x - r < min.x)
-            min.x = pos.x - r;
-        if(pos.y + r > max.y)
-            max.y = pos.y + r;
-        if(pos.y - r < min.y)
-            min.y = pos.y - r;
-    }
-    
-    float sizex = max.x - min.x;
-    float sizey = max.y - min.y;
-    //    float gx = sizex / maxsize;
-    gridx = (int)floor(sizex / maxsize);
-    gridy = (int)floor(sizey / maxsize);
-    
-    // Resize grid
-    grid.resize(gridx);
-    for (int i = 0; i < gridx; i++)
-        grid[i].resize(gridy);
-    
-    // Collect all entities
-    //    Vector2 center = (min + max) * 0.5f;
-    for(Entity2D* e : entities)
-    {
-        // Get the size
-        float r = e->BoundingRadius();
-        
-        // If no collision, then skip this entitiy
-        if(r <= 0)
-            continue;
-        
-        // Build the grid size
-        Vector2 pos = e->Position();
-        pos = pos - min;
-        int i = (pos.x / sizex) * gridx;
-        int j = (pos.y / sizey) * gridy;
-        grid[i][j].push_back(e);
-    }
+    SafeDelete(broadphase);
 }
 
-vector<Entity2D*> Grid::GetNeighbours(Entity2D &entity)
+////////////////////////////////////////////////////////////////////////////////
+// SetBroadphase
+////////////////////////////////////////////////////////////////////////////////
+void CollisionManager::SetBroadphase(BroadphaseType type)
 {
-    vector<Entity2D*> neighbours;
-    float sizex = max.x - min.x;
-    float sizey = max.y - min.y;
-    
-    Vector2 pos = entity.Position();
-    pos = pos - min;
-    int idx = (pos.x / sizex) * gridx;
-    int jdx = (pos.y / sizey) * gridy;
-    //
-    int ifrom = idx <= 0 ? 0 : idx - 1;
-    int jfrom = jdx <= 0 ? 0 : jdx - 1;
-    int ito = (idx >= (gridx - 1)) ? (gridx - 1) : (idx + 1);
-    int jto = (jdx >= (gridy - 1)) ? (gridy - 1) : (jdx + 1);
+    SafeDelete(broadphase);
+    broadphaseType = type;
     
-    for(int i = ifrom; i <= ito; i++)
+    switch (type)
     {
-        for(int j = jfrom; j <= jto; j++)
-        {
-            for(auto e : grid[i][j])
-                neighbours.push_back(e);
-        }
+        case BROADPHASE_SWEEP_AND_PRUNE:
+            broadphase = new SweepAndPrune();
+            break;
+            
+        case BROADPHASE_DYNAMIC_TREE:
+            broadphase = new DynamicTree();
+            break;
+            
+        case BROADPHASE_SPATIAL_HASH:
+        default:
+            broadphase = new SpatialHash();
+            break;
     }
     
-    return neighbours;
+    UpdateActiveLayers();
 }
 
-#ifdef DEBUG
-void Grid::DebugRender()
+
+////////////////////////////////////////////////////////////////////////////////
+// Add a pair of ids to ignore, like multiple bodies used for one 
+////////////////////////////////////////////////////////////////////////////////
+void CollisionManager::IgnoreByIDs(uint id0, uint id1)
 {
-    float sizex = max.x - min.x;
-    float sizey = max.y - min.y;
-    
-    float dx = sizex / gridx;
-    float dy = sizey / gridy;
-    float x = min.x;
-    float y = min.y;
-    //
-    for (int i = 0; i <= gridx; i++, x += dx)
-        gDebugDraw2D.AddLine(Vector2(x, min.y),
-                             Vector2(x, max.y),
-                             Color::Grey);
-    
-    for (int i = 0; i <= gridy; i++, y += dy)
-        gDebugDraw2D.AddLine(Vector2(min.x, y),
-                             Vector2(max.x, y),
-                             Color::Grey);
+    ignorePairs.Insert( CalcPairID(id0, id1) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Remove a pair of ids from the ignored
+////////////////////////////////////////////////////////////////////////////////
+void CollisionManager::UnignoreByIDs(uint id0, uint id1)
+{
+    ignorePairs.Remove( CalcPairID(id0, id1) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Add a type of collision to ignore
+////////////////////////////////////////////////////////////////////////////////
+void CollisionManager::IgnoreByType(int ignoreType)
+{
+    ignore.push_back(ignoreType);
+    ignoreTypeCache.clear();
+}
 
-    for (int i = 0; i < gridx; i++)
+////////////////////////////////////////////////////////////////////////////////
+// SetLayerCollision
+////////////////////////////////////////////////////////////////////////////////
+void CollisionManager::SetLayerCollision(uint layer0, uint layer1, bool collide)
+{
+    // Keep the matrix symmetric
+    if(collide)
     {
-        for (int j = 0; j < gridy; j++)
-        {
-            Vector2 c(i * dx, j * dy);
-            c += Vector2(dx/2, dy/2);
-            c += min;
-            gDebugDraw2D.AddPoint(c);
-            
-            for(auto e : grid[i][j])
-            {
-                gDebugDraw2D.AddLine(e->Position(), c, Color::Grey);
-            }
-        }
+        layerMasks[layer0] |= 1u << layer1;
+        layerMasks[layer1] |= 1u << layer0;
     }
+    else
+    {
+        layerMasks[layer0] &= ~(1u << layer1);
+        layerMasks[layer1] &= ~(1u << layer0);
+    }
+    
+    UpdateActiveLayers();
 }
-#endif
-
 
+////////////////////////////////////////////////////////////////////////////////
+// SetLayerMask
+////////////////////////////////////////////////////////////////////////////////
+void CollisionManager::SetLayerMask(uint layer, uint mask)
+{
+    for(uint other = 0; other < MaxCollisionLayers; other++)
+        SetLayerCollision(layer, other, (mask & (1u << other)) != 0);
+}
 
 ////////////////////////////////////////////////////////////////////////////////
-// Add a pair of ids to ignore, like multiple bodies used for one 
+// UpdateActiveLayers
 ////////////////////////////////////////////////////////////////////////////////
-void CollisionManager::IgnoreByIDs(uint id0, uint id1)
+void CollisionManager::UpdateActiveLayers()
 {
-    ignorePairs.push_back( CalcPairID(id0, id1) );
+    uint active = 0;
+    for(int i = 0; i < MaxCollisionLayers; i++)
+        if(layerMasks[i])
+            active |= 1u << i;
+    
+    broadphase->SetActiveLayers(active);
 }
 
 
@@ -184,11 +175,22 @@ uint64 CollisionManager::CalcPairID(uint id0, uint id1)
 ////////////////////////////////////////////////////////////////////////////////
 bool CollisionManager::Ignore(int type)
 {
+    if(ignore.empty())
+        return false;
+    
+    // There are only so many combinations of types, so remember them
+    auto itr = ignoreTypeCache.find(type);
+    if(itr != ignoreTypeCache.end())
+        return itr->second;
+    
+    bool result = false;
     for (int k = 0; k < ignore.size(); k++)
         if ((ignore[k] & type) == type)
         //if ((ignore[k] & type) == ignore[k])
-            return true;
-    return false;
+            result = true;
+    
+    ignoreTypeCache[type] = result;
+    return result;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -196,15 +198,24 @@ bool CollisionManager::Ignore(int type)
 ////////////////////////////////////////////////////////////////////////////////
 bool CollisionManager::Ignore(uint id0, uint id1)
 {
-    // Calc pair ID
-    uint64 pair = CalcPairID(id0, id1);
+    if(ignorePairs.Size() == 0)
+        return false;
     
-    // See if it's stored in the vactor
-    for (int k = 0; k < ignorePairs.size(); k++)
-        if (ignorePairs[k] == pair)
-            return true;
-    //
-    return false;
+    return ignorePairs.Contains( CalcPairID(id0, id1) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ShouldCollide
+////////////////////////////////////////////////////////////////////////////////
+bool CollisionManager::ShouldCollide(const Entity2D* e0, const Entity2D* e1)
+{
+    if(!LayersCollide(e0->CollisionLayer(), e1->CollisionLayer()))
+        return false;
+    
+    if(Ignore(e0->EntityType() | e1->EntityType()))
+        return false;
+    
+    return !Ignore(e0->GetID(), e1->GetID());
 }
 
 
@@ -212,77 +223,117 @@ bool CollisionManager::Ignore(uint id0, uint id1)
 ////////////////////////////////////////////////////////////////////////////////
 // AccumulateContacts
 ////////////////////////////////////////////////////////////////////////////////
-void CollisionManager::AccumulateContacts(const std::list<Entity2D*>& entities)
+void CollisionManager::AccumulateContacts(const std::vector<Entity2D*>& entities)
 {
-    Grid grid(entities);
-    //grid.DebugRender();
+    Stopwatch watch;
+    if(profiling)
+        watch.Start();
+    
+    // Persistent, so only what changed gets touched in here
+    broadphase->Update(entities);
+    //broadphase->DebugRender();
     
-    contacts.clear();
+    // Bodies pulled back by the sweep need to be synced again
+    if(SweepFastBodies(entities))
+        broadphase->Update(entities);
     
-    for (auto e0 : entities)
+    pairs.clear();
+    broadphase->CollectPairs(pairs);
+    
+    if(profiling)
     {
-        // Some have no collision radius and need no attention hence
-        if(e0->BoundingRadius() == 0)
+        timings.Broadphase += watch.Stop();
+        watch.Start();
+    }
+    
+    // Mirror the bodies as disks, non disks get a negative radius. The
+    // world geometry gets cached here, as the narrowphase might be threaded.
+    const std::vector<Entity2D*>& bodies = broadphase->Bodies();
+    disks.Clear();
+    for(Entity2D* e : bodies)
+    {
+        CollisionShape* shape = e->GetCollisionShape();
+        if(shape)
+            shape->UpdateWorld();
+        
+        if(shape && shape->ShapeEnum == COLLISION_SHAPE_DISK)
+            disks.Add(shape->Transform->Translation(), shape->Radius);
+        else
+            disks.Add(e->Position(), -1.0f);
+    }
+    
+    candidates.clear();
+    diskFirst.clear();
+    diskSecond.clear();
+    
+    // Each pair is reported only once, so no duplicates. Disk pairs are
+    // set aside to run in one go.
+    for(const BroadphasePair& pair : pairs)
+    {
+        // Nothing can happen between sleeping and static bodies
+        bool still0 = pair.First->IsSleeping();
+        bool still1 = pair.Second->IsSleeping();
+        if((still0 || still1) &&
+           (still0 || pair.First->InverseMass() == 0) &&
+           (still1 || pair.Second->InverseMass() == 0))
+            continue;
+        
+        if(!ShouldCollide(pair.First, pair.Second))
             continue;
-
-        //
-        auto neighbours = grid.GetNeighbours(*e0);
         
-        for (auto e1 : neighbours)
+        if(disks.IsDisk(pair.FirstIndex) && disks.IsDisk(pair.SecondIndex))
         {
-            // Skip self collision and duplicates
-            if(e0->GetID() <= e1->GetID())
-            //if(e0->GetID() == e1->GetID())
-                continue;
-            
-            Contact contact;
-            
-            /*
-            gDebugDraw2D.AddLine(e0->Position(),
-                                 e1->Position());
-            */
-            
-            //
-            // Perform actual test
-            if( ShapeToShape(e0->GetCollisionShape(),
-                             e1->GetCollisionShape(),
-                             &contact) )
-            {
-                // Fill up info
-                contact.Resolved        = false;
-                contact.Restitution     = 1.0f;
-                
-                // Order entities in a convinient way for use in the
-                // collision events
-                if(e0->EntityType() <= e1->EntityType())
-                {
-                    contact.FirstBody       = e0;
-                    contact.SecondBody      = e1;
-                }
-                else
-                {
-                    contact.FirstBody       = e1;
-                    contact.SecondBody      = e0;
-                    contact.ContactNormal   *= -1.0f;
-                }
-                
-#if DEBUG
-                // Coment this out when not in use
-                gDebugDraw2D.AddLine(contact.FirstBody->Position(),
-                                     contact.FirstBody->Position() + contact.ContactNormal * 1.0f,
-                                     Color::White);
-                
-                // Coment this out when not in use
-                gDebugDraw2D.AddLine(contact.SecondBody->Position(),
-                                     contact.SecondBody->Position() + contact.ContactNormal * -1.0f,
-                                     Color::White);
-#endif
-                contacts.push_back(contact);
-            }
+            diskFirst.push_back(pair.FirstIndex);
+            diskSecond.push_back(pair.SecondIndex);
         }
+        else
+            candidates.push_back(pair);
+    }
+    
+    // Always split the same way, threads or not
+    int chunkCount = GetWorkerCount();
+    buffers.resize(chunkCount);
+    //
+    int pairCount = static_cast<int>(candidates.size() + diskFirst.size());
+    if(jobs && pairCount >= minParallelPairs)
+    {
+        jobs->ParallelFor(chunkCount, 1, [this, chunkCount](int from, int to)
+        {
+            for(int chunk = from; chunk < to; chunk++)
+                CollideChunk(chunk, chunkCount);
+        });
+    }
+    else
+    {
+        for(int chunk = 0; chunk < chunkCount; chunk++)
+            CollideChunk(chunk, chunkCount);
     }
     
-    next =  static_cast<int>(contacts.size());
+    // Merge in chunk order, shape contacts first
+    for(NarrowphaseBuffer& buffer : buffers)
+    {
+        for(int i = 0; i < buffer.shapeContacts; i++)
+        {
+            const BroadphasePair& pair = candidates[buffer.pairs[i]];
+            Contact* contact = contacts.Add(buffer.contacts[i]);
+            if(contact)
+                FinishContact(*contact, pair.First, pair.Second);
+        }
+    }
+    //
+    for(NarrowphaseBuffer& buffer : buffers)
+    {
+        for(int i = buffer.shapeContacts; i < (int)buffer.contacts.size(); i++)
+        {
+            int pair = buffer.pairs[i];
+            Contact* contact = contacts.Add(buffer.contacts[i]);
+            if(contact)
+                FinishContact(*contact, bodies[diskFirst[pair]], bodies[diskSecond[pair]]);
+        }
+    }
+    
+    if(profiling)
+        timings.Narrowphase += watch.Stop();
             
     
     /*
@@ -383,42 +434,238 @@ void CollisionManager::AccumulateContacts(const std::list<Entity2D*>& entities)
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+// SweepFastBodies
+////////////////////////////////////////////////////////////////////////////////
+bool CollisionManager::SweepFastBodies(const std::vector<Entity2D*>& entities)
+{
+    sweptBodies = 0;
+    
+    for(Entity2D* e : entities)
+    {
+        // Only dynamic entities move on their own
+        if(e->InverseMass() == 0)
+            continue;
+        
+        DynamicEntity2D* body = static_cast<DynamicEntity2D*>(e);
+        float threshold = body->SweepThreshold();
+        if(threshold <= 0.0f ||
+           body->Velocity().SquareMagnitude() <= threshold * threshold)
+            continue;
+        
+        Vector2 from    = body->LastPosition();
+        Vector2 to      = body->Position();
+        Vector2 d       = to - from;
+        float length    = d.Magnitude();
+        if(length == 0.0f)
+            continue;
+        
+        // Swept as a disk, which is exact for disks and a bit early for
+        // anything else
+        float radius    = body->BoundingRadius();
+        AABB box        = AABB::Merge(AABB::FromDisk(from, radius),
+                                      AABB::FromDisk(to, radius));
+        float toi       = 1.0f;
+        float t;
+        
+        wallTree.Query(box, [&](int j)
+        {
+            if(SweepDiskToLineSeg(from, to, radius, wallTree.Segment(j), t) && t < toi)
+                toi = t;
+        });
+        
+        // Other bodies are taken where they are now
+        sweepQuery.clear();
+        broadphase->Query(box, sweepQuery);
+        for(Entity2D* other : sweepQuery)
+        {
+            if(other == e || !ShouldCollide(e, other))
+                continue;
+            
+            if(SweepDiskToDisk(from, to, radius,
+                               other->Position(),
+                               other->BoundingRadius(), t) && t < toi)
+                toi = t;
+        }
+        
+        if(toi >= 1.0f)
+            continue;
+        
+        // Just past the impact, the rest of the motion for this step is lost
+        float s = std::min(1.0f, toi + sweepSlop * radius / length);
+        body->SetPosition(from + d * s);
+        sweptBodies++;
+    }
+    
+    return sweptBodies > 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Collide
+////////////////////////////////////////////////////////////////////////////////
+bool CollisionManager::Collide(const Entity2D* e0, const Entity2D* e1, Contact& contact) const
+{
+    // Do an early out test on the bounding radii, skips the sqrt
+    Vector2 delta   = e0->Position() - e1->Position();
+    float rsum      = e0->BoundingRadius() + e1->BoundingRadius();
+    if(delta.SquareMagnitude() >= rsum * rsum)
+        return false;
+    
+    //
+    // Perform actual test
+    return ShapeToShape(e0->GetCollisionShape(),
+                        e1->GetCollisionShape(),
+                        &contact);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CollideChunk
+////////////////////////////////////////////////////////////////////////////////
+void CollisionManager::CollideChunk(int chunk, int chunkCount)
+{
+    NarrowphaseBuffer& buffer = buffers[chunk];
+    buffer.contacts.clear();
+    buffer.pairs.clear();
+    
+    // Shape to shape, one by one
+    int count   = static_cast<int>(candidates.size());
+    int begin   = count * chunk / chunkCount;
+    int end     = count * (chunk + 1) / chunkCount;
+    //
+    for(int i = begin; i < end; i++)
+    {
+        Contact contact;
+        if(Collide(candidates[i].First, candidates[i].Second, contact))
+        {
+            buffer.contacts.push_back(contact);
+            buffer.pairs.push_back(i);
+        }
+    }
+    buffer.shapeContacts = static_cast<int>(buffer.contacts.size());
+    
+    // Disks in one go
+    count   = static_cast<int>(diskFirst.size());
+    begin   = count * chunk / chunkCount;
+    end     = count * (chunk + 1) / chunkCount;
+    if(begin == end)
+        return;
+    
+    // Make room for the worst case and trim after
+    int start = buffer.shapeContacts;
+    buffer.contacts.resize(start + end - begin);
+    buffer.pairs.resize(start + end - begin);
+    
+    int found = DiskToDiskBatch(disks,
+                                &diskFirst[begin],
+                                &diskSecond[begin],
+                                end - begin,
+                                &buffer.contacts[start],
+                                &buffer.pairs[start]);
+    
+    // Hits are relative to the start of the range
+    buffer.contacts.resize(start + found);
+    buffer.pairs.resize(start + found);
+    for(int i = start; i < start + found; i++)
+        buffer.pairs[i] += begin;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// FinishContact
+////////////////////////////////////////////////////////////////////////////////
+void CollisionManager::FinishContact(Contact& contact, Entity2D* e0, Entity2D* e1)
+{
+    // Getting touched by an awake body wakes up the whole island
+    if(e0->IsSleeping())
+        static_cast<DynamicEntity2D*>(e0)->Wake();
+    if(e1->IsSleeping())
+        static_cast<DynamicEntity2D*>(e1)->Wake();
+    
+    // Fill up info
+    contact.Resolved            = false;
+    contact.VelocityResloved    = false;
+    contact.Restitution         = restitution;
+    contact.ID                  = CalcPairID(e0->GetID(), e1->GetID());
+    
+    // Order entities in a convinient way for use in the
+    // collision events
+    if(e0->EntityType() <= e1->EntityType())
+    {
+        contact.FirstBody       = e0;
+        contact.SecondBody      = e1;
+    }
+    else
+    {
+        contact.FirstBody       = e1;
+        contact.SecondBody      = e0;
+        contact.ContactNormal   *= -1.0f;
+    }
+    
+#if DEBUG
+    // Coment this out when not in use
+    gDebugDraw2D.AddLine(contact.FirstBody->Position(),
+                         contact.FirstBody->Position() + contact.ContactNormal * 1.0f,
+                         Color::White);
+    
+    // Coment this out when not in use
+    gDebugDraw2D.AddLine(contact.SecondBody->Position(),
+                         contact.SecondBody->Position() + contact.ContactNormal * -1.0f,
+                         Color::White);
+#endif
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // AccumulateContacts
 ////////////////////////////////////////////////////////////////////////////////
-void CollisionManager::AccumulateContacts(const std::list<Entity2D*>& entities,
+void CollisionManager::AccumulateContacts(const std::vector<Entity2D*>& entities,
                                           const std::vector<LineSegment>&     walls)
 {
+    Stopwatch watch;
+    if(profiling)
+        watch.Start();
+    
+    // Walls were changed without telling
+    if(wallTree.Count() != (int)walls.size())
+        wallTree.Build(walls);
+    
     // Over all entities
-    std::list<Entity2D*>::const_iterator itr = entities.begin();
-    for(; itr != entities.end() && next < maxContacts; itr++)
+    std::vector<Entity2D*>::const_iterator itr = entities.begin();
+    for(; itr != entities.end(); itr++)
     {
         // Get them elements
         Entity2D*         bge     = *itr;
         
-        // Skip kinematic entities for optimization
-        if(bge->InverseMass() == 0)
+        // Skip kinematic and sleeping entities for optimization
+        if(bge->InverseMass() == 0 || bge->IsSleeping())
             continue;
         
-        // Over all walls
-        for(int j = 0; j < walls.size() && next < maxContacts; j++)
+        CollisionShape* shape = bge->GetCollisionShape();
+        shape->UpdateWorld();
+        AABB box = AABB::FromDisk(bge->Position(), bge->BoundingRadius());
+        
+        // Only the walls that might be touching
+        wallTree.Query(box, [&](int j)
         {
-            LineSegment const*      wall    = &walls[j];
-            CollisionShape*         shape   = bge->GetCollisionShape();
-            Contact*                contact = &contacts[next];
-            
             // Run some tests
-            if( CollisionShapeToLineSeg(shape, wall, contact) )
+            Contact contact;
+            if( CollisionShapeToLineSeg(shape, &wallTree.Segment(j), &contact) )
             {
-                contact->FirstBody      = bge;
-                contact->SecondBody     = 0;
-                contact->Resolved       = false;
-                contact->Restitution    = 1.0f; // TODO: Restitution
+                contact.FirstBody      = bge;
+                contact.SecondBody     = 0;
+                contact.Resolved       = false;
+                contact.Restitution    = restitution;
+                contact.ID             = WallPairID(bge->GetID(), j);
                 //
-                next++;
+                contacts.Add(contact);
             }
-        }
+        });
     }
+    
+    if(profiling)
+        timings.Walls += watch.Stop();
 }
 
 
@@ -427,42 +674,95 @@ void CollisionManager::AccumulateContacts(const std::list<Entity2D*>& entities,
 ////////////////////////////////////////////////////////////////////////////////
 void CollisionManager::ResolveContacts()
 {
-    // Run through all the contacts in the frame
-    for(int i = 0; i < next; ++i)
+    Stopwatch watch;
+    if(profiling)
+        watch.Start();
+    
+    stats.Contacts              = contacts.Count();
+    stats.PositionIterations    = 0;
+    stats.PositionResidual      = 0.0f;
+    
+    // Remember where everything started
+    startPositions.resize(2 * contacts.Count());
+    for(int i = 0; i < contacts.Count(); ++i)
     {
-        Contact& contact = contacts[i];
-        
-        // Check if it has been handeled in the event
-        if(!contact.Resolved && contact.Penetration > 0) 
+        const Contact& contact  = contacts[i];
+        startPositions[2 * i]   = contact.FirstBody->Position();
+        if(contact.SecondBody)
+            startPositions[2 * i + 1] = contact.SecondBody->Position();
+    }
+    
+    // Moving a body for one contact changes the others it's in, so go over
+    // them a few times
+    for(int k = 0; k < positionIterations; ++k)
+    {
+        float worst = 0.0f;
+        for(int i = 0; i < contacts.Count(); ++i)
         {
-            // Check type of collision
-            if(contact.SecondBody != 0)
-            {
-                Entity2D & first = *contact.FirstBody;
-                Entity2D & second = *contact.SecondBody;
-                
-                // The movement of each object is based on inverse mass, so total that
-                float totalInverseMass = first.InverseMass() + second.InverseMass();
-                
-                // If both have infinite mass, skip this contact
-                if (totalInverseMass <= 0) continue;
-                
-                // Calculate amount of penetration resoluion per total inverse mass
-                Vector2 movePerInverseMass = contact.ContactNormal *
-                                            (-contact.Penetration / totalInverseMass);
-                
-                // Move 'em
-                first.SetPosition( first.Position() - movePerInverseMass * first.InverseMass() );
-                second.SetPosition( second.Position() + movePerInverseMass * second.InverseMass() );
-            }                    
-            else
-            {
-                // Collision with walls
-                contact.FirstBody->SetPosition( contact.FirstBody->Position() +
-                                               contact.ContactNormal * contact.Penetration );
-            }
+            float penetration = SolvePosition(i);
+            if(penetration > worst)
+                worst = penetration;
         }
+        
+        stats.PositionIterations++;
+        stats.PositionResidual = worst;
+        if(worst < positionTolerance)
+            break;
+    }
+    
+    if(profiling)
+        timings.Resolve += watch.Stop();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SolvePosition
+////////////////////////////////////////////////////////////////////////////////
+float CollisionManager::SolvePosition(int i)
+{
+    Contact& contact = contacts[i];
+    
+    // Check if it has been handeled in the event
+    if(contact.Resolved)
+        return 0.0f;
+    
+    // Estimate what is left from how much the bodies moved along the normal
+    Vector2 moved = contact.FirstBody->Position() - startPositions[2 * i];
+    if(contact.SecondBody)
+        moved -= contact.SecondBody->Position() - startPositions[2 * i + 1];
+    //
+    float penetration = contact.Penetration - moved.DotProduct(contact.ContactNormal);
+    if(penetration <= 0.0f)
+        return 0.0f;
+    
+    // Check type of collision
+    if(contact.SecondBody != 0)
+    {
+        Entity2D & first = *contact.FirstBody;
+        Entity2D & second = *contact.SecondBody;
+        
+        // The movement of each object is based on inverse mass, so total that
+        float totalInverseMass = first.InverseMass() + second.InverseMass();
+        
+        // If both have infinite mass, skip this contact
+        if (totalInverseMass <= 0)
+            return 0.0f;
+        
+        // Calculate amount of penetration resoluion per total inverse mass
+        Vector2 movePerInverseMass = contact.ContactNormal *
+                                    (-penetration / totalInverseMass);
+        
+        // Move 'em
+        first.SetPosition( first.Position() - movePerInverseMass * first.InverseMass() );
+        second.SetPosition( second.Position() + movePerInverseMass * second.InverseMass() );
+    }
+    else
+    {
+        // Collision with walls
+        contact.FirstBody->SetPosition( contact.FirstBody->Position() +
+                                       contact.ContactNormal * penetration );
     }
+    
+    return penetration;
 }
 
 
@@ -471,53 +771,256 @@ void CollisionManager::ResolveContacts()
 ////////////////////////////////////////////////////////////////////////////////
 void CollisionManager::ResolveVelocity()
 {
-    // Run through all the contacts in the frame
-    for(int i = 0; i < next; ++i)
+    Stopwatch watch;
+    if(profiling)
+        watch.Start();
+    
+    frame++;
+    
+    // Set the targets and warm start from the last frame
+    for(int i = 0; i < contacts.Count(); ++i)
     {
         Contact& contact = contacts[i];
+        contact.NormalImpulse = 0.0f;
+        
+        // Gamplay does not need it to be resolved
+        if(contact.Resolved || contact.VelocityResloved)
+            continue;
         
         // Get the velocity in the direction of the contact
         float separatingVelocity = contact.SeparatingVelocity();
         
-        // Check if there is anything to resolve
-        if(separatingVelocity > 0 || contact.Resolved || contact.VelocityResloved)
-        {
-            // Contact separating or stationary, move along nothing to see
-            // Or gamplay does not need it to be resolved
+        // Bounce back only the approaching ones
+        if(separatingVelocity < -restitutionThreshold)
+            contact.TargetVelocity = -separatingVelocity * contact.Restitution;
+        else
+            contact.TargetVelocity = 0.0f;
+        
+        if(!warmStarting)
             continue;
+        
+        // Only reuse the impulse if the contact didn't turn much
+        auto itr = contactCache.find(contact.ID);
+        if(itr != contactCache.end() &&
+           itr->second.normal.DotProduct(contact.ContactNormal) > 0.95f)
+        {
+            contact.NormalImpulse = itr->second.impulse;
+            ApplyImpulse(contact, contact.NormalImpulse);
+        }
+    }
+    
+    stats.VelocityIterations    = 0;
+    stats.VelocityResidual      = 0.0f;
+    
+    // Run through all the contacts in the frame, until nothing changes much
+    for(int k = 0; k < velocityIterations; ++k)
+    {
+        float worst = 0.0f;
+        for(int i = 0; i < contacts.Count(); ++i)
+        {
+            Contact& contact = contacts[i];
+            if(contact.Resolved || contact.VelocityResloved)
+                continue;
+            
+            float change = fabsf(SolveVelocity(contact));
+            if(change > worst)
+                worst = change;
         }
         
-        // Calculate new separating velocity
-        float newSepVelocity = -separatingVelocity * contact.Restitution;
+        stats.VelocityIterations++;
+        stats.VelocityResidual = worst;
+        if(worst < velocityTolerance)
+            break;
+    }
+    
+    StoreContacts();
+    
+    if(profiling)
+        timings.Resolve += watch.Stop();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SolveVelocity
+////////////////////////////////////////////////////////////////////////////////
+float CollisionManager::SolveVelocity(Contact& contact)
+{
+    // The movement of each object is based on inverse mass, so total that
+    float totalInverseMass = contact.FirstBody->InverseMass();
+    if(contact.SecondBody)
+        totalInverseMass += contact.SecondBody->InverseMass();
+    
+    if (totalInverseMass <= 0.0f)
+        return 0.0f;
+    
+    float separatingVelocity    = contact.SeparatingVelocity();
+    float impulse               = (contact.TargetVelocity - separatingVelocity) / totalInverseMass;
+    
+    // Contacts can only push, so clamp the total and not the change
+    float accumulated       = contact.NormalImpulse + impulse;
+    if(accumulated < 0.0f)
+        accumulated = 0.0f;
+    impulse                 = accumulated - contact.NormalImpulse;
+    contact.NormalImpulse   = accumulated;
+    
+    ApplyImpulse(contact, impulse);
+    return impulse * totalInverseMass;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ApplyImpulse
+////////////////////////////////////////////////////////////////////////////////
+void CollisionManager::ApplyImpulse(Contact& contact, float impulse)
+{
+    if(impulse == 0.0f)
+        return;
+    
+    Vector2 impulsePerMass = contact.ContactNormal * impulse;
+    
+    if(contact.FirstBody && !contact.FirstBody->HasInifitesMass())
+    {
+        DynamicEntity2D* mv = static_cast<DynamicEntity2D*>(contact.FirstBody);
+        mv->SetVelocity(mv->Velocity() + impulsePerMass * mv->InverseMass());
+    }
+    
+    if(contact.SecondBody && !contact.SecondBody->HasInifitesMass())
+    {
+        DynamicEntity2D* mv = static_cast<DynamicEntity2D*>(contact.SecondBody);
+        mv->SetVelocity(mv->Velocity() + impulsePerMass * -mv->InverseMass());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// StoreContacts
+////////////////////////////////////////////////////////////////////////////////
+void CollisionManager::StoreContacts()
+{
+    for(int i = 0; i < contacts.Count(); ++i)
+    {
+        const Contact& contact = contacts[i];
+        if(contact.Resolved || contact.VelocityResloved)
+            continue;
         
-        float delataVelocity = newSepVelocity - separatingVelocity;
+        CachedContact& cached   = contactCache[contact.ID];
+        cached.normal           = contact.ContactNormal;
+        cached.impulse          = contact.NormalImpulse;
+        cached.frame            = frame;
+    }
+    
+    // Expire the ones that haven't been seen for a while
+    for(auto itr = contactCache.begin(); itr != contactCache.end();)
+    {
+        if(frame - itr->second.frame >= contactLifetime)
+            itr = contactCache.erase(itr);
+        else
+            ++itr;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// UpdateIslands
+////////////////////////////////////////////////////////////////////////////////
+void CollisionManager::UpdateIslands(const std::vector<Entity2D*>& entities, float dt)
+{
+    sleepingBodies = 0;
+    islandBodies.clear();
+    
+    // Advance the timers of the awake bodies
+    float sleepVelocitySq = sleepVelocity * sleepVelocity;
+    for(Entity2D* e : entities)
+    {
+        if(e->InverseMass() == 0)
+            continue;
         
-        // The movement of each object is based on inverse mass, so total that
-        float totalInverseMass = contact.FirstBody->InverseMass();
-        if(contact.SecondBody)
+        DynamicEntity2D* body = static_cast<DynamicEntity2D*>(e);
+        if(body->IsSleeping())
         {
-           totalInverseMass += contact.SecondBody->InverseMass();
+            sleepingBodies++;
+            continue;
         }
         
-        if (totalInverseMass <= 0.0f)
-            continue;
+        // A body that can't sleep keeps its whole island awake
+        if(sleepingEnabled &&
+           body->sleepingAllowed &&
+           body->velocity.SquareMagnitude() <= sleepVelocitySq)
+            body->sleepTime += dt;
+        else
+            body->sleepTime = 0.0f;
         
-        float impulse = delataVelocity / totalInverseMass;
+        body->islandIndex = static_cast<int>(islandBodies.size());
+        islandBodies.push_back(body);
+    }
+    
+    if(!sleepingEnabled)
+        return;
+    
+    int count = static_cast<int>(islandBodies.size());
+    islandParent.resize(count);
+    for(int i = 0; i < count; i++)
+        islandParent[i] = i;
+    
+    // Join the bodies that touch, static bodies don't join anything
+    for(int i = 0; i < contacts.Count(); ++i)
+    {
+        const Contact& contact = contacts[i];
+        if(!contact.SecondBody ||
+           contact.FirstBody->InverseMass() == 0 ||
+           contact.SecondBody->InverseMass() == 0)
+            continue;
         
-        Vector2 impulsePerMass = contact.ContactNormal * impulse;
+        int root0 = FindIsland(static_cast<DynamicEntity2D*>(contact.FirstBody)->islandIndex);
+        int root1 = FindIsland(static_cast<DynamicEntity2D*>(contact.SecondBody)->islandIndex);
+        if(root0 != root1)
+            islandParent[root0] = root1;
+    }
+    
+    // The body that moved last decides for the whole island
+    islandSleepTime.assign(count, FLT_MAX);
+    for(int i = 0; i < count; i++)
+    {
+        int root = FindIsland(i);
+        islandSleepTime[root] = std::min(islandSleepTime[root], islandBodies[i]->sleepTime);
+    }
+    
+    // Put the resting islands to sleep, linking each in a ring so that
+    // waking any body wakes them all
+    islandRing.assign(count, 0);
+    for(int i = 0; i < count; i++)
+    {
+        int root = FindIsland(i);
+        if(islandSleepTime[root] < timeToSleep)
+            continue;
         
-        if(contact.FirstBody && !contact.FirstBody->HasInifitesMass())
+        DynamicEntity2D* body = islandBodies[i];
+        DynamicEntity2D* ring = islandRing[root];
+        if(ring)
         {
-            DynamicEntity2D* mv = static_cast<DynamicEntity2D*>(contact.FirstBody);
-            mv->SetVelocity(mv->Velocity() + impulsePerMass * mv->InverseMass());
+            body->islandNext = ring->islandNext;
+            ring->islandNext = body;
         }
-        
-        if(contact.SecondBody && !contact.SecondBody->HasInifitesMass())
+        else
         {
-            DynamicEntity2D* mv = static_cast<DynamicEntity2D*>(contact.SecondBody);
-            mv->SetVelocity(mv->Velocity() + impulsePerMass * -mv->InverseMass());
-        }        
+            body->islandNext = body;
+            islandRing[root] = body;
+        }
+        
+        body->sleeping = true;
+        body->velocity.Clear();
+        body->force.Clear();
+        sleepingBodies++;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// FindIsland
+////////////////////////////////////////////////////////////////////////////////
+int CollisionManager::FindIsland(int i)
+{
+    while(islandParent[i] != i)
+    {
+        islandParent[i] = islandParent[islandParent[i]];
+        i = islandParent[i];
     }
+    return i;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -526,7 +1029,7 @@ void CollisionManager::ResolveVelocity()
 void CollisionManager::RaiseContactEvents()
 {
     // Run through all the contacts in the frame
-    for(int i = 0; i < next; ++i)
+    for(int i = 0; i < contacts.Count(); ++i)
         gameWorld->HandleContactEvent(contacts[i]);
 }
 
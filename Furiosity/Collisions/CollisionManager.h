@@ -10,44 +10,74 @@
 #include <vector>
 #include <map>
 #include <list>
+#include <unordered_map>
 
 // Local
 #include "Contact.h"
+#include "ContactPool.h"
 #include "Entity2D.h"
+#include "Broadphase.h"
+#include "CollisionMethods.h"
+#include "SegmentTree.h"
+#include "PairSet.h"
+#include "JobSystem.h"
 
 using std::list;
 
 namespace Furiosity 
 {
-    typedef unsigned long long uint64;
+    // Fwd
+    class GameWorld;
+    class DynamicEntity2D;
     
-    class Grid
+    ///
+    /// What the solver did in the last step
+    ///
+    struct SolverStats
     {
-    public:
-        Grid(const list<Entity2D*>& entities);
-                
-        vector<Entity2D*> GetNeighbours(Entity2D& entity);
+        /// Contacts handed to the solver
+        int     Contacts;
         
-#ifdef DEBUG
-        void virtual DebugRender();
-#endif
+        /// Iterations actually run, can be less than the budget
+        int     VelocityIterations;
+        int     PositionIterations;
         
-    protected:
-        int gridx;
-        int gridy;
-        
-        //float xSize;
-        //float ySize;
+        /// Largest velocity change in the last velocity iteration
+        float   VelocityResidual;
         
-        //Vector2 center;
-        Vector2 min;
-        Vector2 max;
+        /// Largest penetration left before the last position iteration
+        float   PositionResidual;
         
-        vector<vector<vector<Entity2D*>>> grid;
+        SolverStats() : Contacts(0),
+                        VelocityIterations(0),
+                        PositionIterations(0),
+                        VelocityResidual(0.0f),
+                        PositionResidual(0.0f) {}
     };
     
-    // Fwd
-    class GameWorld;
+    ///
+    /// Where the time went in the last step, in seconds. Only measured when
+    /// profiling is on.
+    ///
+    struct CollisionTimings
+    {
+        /// Syncing the broadphase, sweeping and collecting the pairs
+        double  Broadphase;
+        
+        /// Filtering the pairs and running the tests
+        double  Narrowphase;
+        
+        /// Contacts with the walls
+        double  Walls;
+        
+        /// Position and velocity solving
+        double  Resolve;
+        
+        CollisionTimings() : Broadphase(0.0),
+                             Narrowphase(0.0),
+                             Walls(0.0),
+                             Resolve(0.0) {}
+    };
     
     ////////////////////////////////////////////////////////////////////////////////
     // Collision Manager
@@ -57,24 +87,155 @@ namespace Furiosity
     // can subscribe to event when entites collide.
     ////////////////////////////////////////////////////////////////////////////////
     class CollisionManager
-    {        
-    protected:        
-        // Collection of contacts, these are shared and reused
-        std::vector<Contact> contacts;
-        
-        // The next slot in the contact vector
-        int next;
+    {
+    public:
+        // Number of collision layers
+        enum { MaxCollisionLayers = 32 };
         
-        // This is the maximum number of contacts supported
-        // above this number collisions are ignored
-        int maxContacts;
+    protected:        
+        // Contacts of the current step, the memory is reused across steps
+        // and pointers to the contacts stay good until the next Clear
+        ContactPool contacts;
         
         // A vector of collision types to ignore
         std::vector<int> ignore;
         
-        std::vector<uint64> ignorePairs;
+        // Results of checking a type against the ignore vector
+        std::unordered_map<int, bool> ignoreTypeCache;
+        
+        // Pairs of entities that should not collide, by pair ID
+        PairSet ignorePairs;
+        
+        // For each layer, a bit mask of the layers it collides with
+        uint layerMasks[MaxCollisionLayers];
+        
+        // Persistent broadphase, kept in sync with the entities on every step
+        Broadphase* broadphase;
+        
+        // The kind of broadphase in use
+        BroadphaseType broadphaseType;
+        
+        // Candidate pairs from the broadphase, reused every step
+        std::vector<BroadphasePair> pairs;
+        
+        // The broadphase bodies as disks, for the batched narrowphase
+        DiskBatch disks;
+        
+        // Disk to disk pairs, as indices into disks
+        std::vector<int> diskFirst;
+        std::vector<int> diskSecond;
+        
+        // Pairs that passed the filters but are not both disks
+        std::vector<BroadphasePair> candidates;
+        
+        // Contacts found by one chunk of the narrowphase
+        struct NarrowphaseBuffer
+        {
+            // The shape to shape contacts come first, then the disk ones
+            std::vector<Contact>    contacts;
+            
+            // The pair each contact came from, indices into the candidates
+            // for the first ones and into the disk pairs for the rest
+            std::vector<int>        pairs;
+            
+            // How many of the contacts are shape to shape
+            int                     shapeContacts;
+        };
+        
+        // One buffer per chunk, merged in order so that the contacts come out
+        // the same no matter how many threads did the work
+        std::vector<NarrowphaseBuffer> buffers;
+        
+        // Jobs for the narrowphase, null when running on a single thread
+        JobSystem* jobs;
+        
+        // Below this many pairs the narrowphase stays on the calling thread
+        int minParallelPairs;
+        
+        // Static hierarchy over the level walls
+        SegmentTree wallTree;
+        
+        // Bodies near a swept body, reused every step
+        std::vector<Entity2D*> sweepQuery;
+        
+        // Fast bodies that were pulled back to a time of impact last step
+        int sweptBodies;
+        
+        // The awake dynamic bodies, reused every step
+        std::vector<DynamicEntity2D*> islandBodies;
+        
+        // Union-find over the awake bodies, joined by the contacts
+        std::vector<int> islandParent;
+        
+        // For each island root, the shortest time a body spent resting
+        std::vector<float> islandSleepTime;
+        
+        // For each island root, a body in the ring when going to sleep
+        std::vector<DynamicEntity2D*> islandRing;
+        
+        // Lets islands go to sleep
+        bool sleepingEnabled;
+        
+        // Bodies slower than this count as resting
+        float sleepVelocity;
+        
+        // An island sleeps once all its bodies have rested this long
+        float timeToSleep;
+        
+        // Bodies that were sleeping in the last step
+        int sleepingBodies;
+        
+        // How far past the time of impact a swept body is placed, as a part
+        // of its radius, so the regular tests pick up the contact
+        float sweepSlop;
+        
+        // What is remembered about a contact between frames
+        struct CachedContact
+        {
+            Vector2 normal;
+            float   impulse;
+            uint    frame;
+        };
+        
+        // Contacts from the previous frames, by pair ID
+        std::unordered_map<uint64, CachedContact> contactCache;
+        
+        // Counts the steps, used to expire cached contacts
+        uint frame;
+        
+        // Number of frames a cached contact is kept without being touched
+        uint contactLifetime;
+        
+        // Use the cached impulses as a starting point
+        bool warmStarting;
+        
+        // Contacts approaching slower than this don't bounce, in units per
+        // second. Above zero so resting contacts don't jitter.
+        float restitutionThreshold;
+        
+        // Restitution given to all new contacts
+        float restitution;
         
-//        int64
+        // Iteration budgets of the solver
+        int velocityIterations;
+        int positionIterations;
+        
+        // The solver stops early once the residuals are below these
+        float velocityTolerance;
+        float positionTolerance;
+        
+        // Where the bodies of each contact were before the position solve,
+        // used to estimate the penetration that is left
+        std::vector<Vector2> startPositions;
+        
+        // Stats from the last step
+        SolverStats stats;
+        
+        // Measure the time spent in each phase
+        bool profiling;
+        
+        // Times from the last step
+        CollisionTimings timings;
         
         // Pointer to the class that is handling the events
         GameWorld* gameWorld;
@@ -86,33 +247,196 @@ namespace Furiosity
         
         bool Ignore(uint id0, uint id1);
         
+        // All the filters, from the cheapest up
+        bool ShouldCollide(const Entity2D* e0, const Entity2D* e1);
+        
+        // Lets the broadphase know which layers can be skipped
+        void UpdateActiveLayers();
+        
+        // Pair ID for a body and a wall, can't clash with pairs of bodies
+        uint64 WallPairID(uint id, int wall) const
+        {
+            return (uint64(id) << 32) | (0x80000000u | uint(wall));
+        }
+        
+        // Applies an impulse along the contact normal to both bodies
+        void ApplyImpulse(Contact& contact, float impulse);
+        
+        // Pushes the contact towards its target velocity, keeping the
+        // accumulated impulse positive. Returns the change in velocity.
+        float SolveVelocity(Contact& contact);
+        
+        // Moves the bodies apart by what is left of the penetration.
+        // Returns the penetration before moving.
+        float SolvePosition(int i);
+        
+        // Remembers the impulses and drops contacts that are gone
+        void StoreContacts();
+        
+        // Root of the island, halving the path on the way
+        int FindIsland(int i);
+        
+        // Runs the narrowphase on a candidate pair from the broadphase,
+        // only fills in the normal and penetration
+        bool Collide(const Entity2D* e0, const Entity2D* e1, Contact& contact) const;
+        
+        // Runs the narrowphase on a part of the candidates and disk pairs.
+        // Only touches its own buffer, so chunks can run in parallel.
+        void CollideChunk(int chunk, int chunkCount);
+        
+        // Fills up the rest of a contact found between two entities
+        void FinishContact(Contact& contact, Entity2D* e0, Entity2D* e1);
+        
+        // Sweeps the bodies moving faster than their threshold from where
+        // they were at the start of the step, against the walls and the other
+        // bodies. Bodies that would have tunneled get pulled back to the first
+        // time of impact. Returns true if any body was moved.
+        bool SweepFastBodies(const std::vector<Entity2D*>& entities);
+        
     public:
-        // Ctor
-        CollisionManager(GameWorld* gameWorld, int maxContacts)
-        : gameWorld(gameWorld),
-          maxContacts(maxContacts),
-          contacts(maxContacts),
-          next(0)
-          //ignore(16)
-        {}
+        // Ctor, makes room for this many contacts up front. More are added
+        // as needed.
+        CollisionManager(GameWorld* gameWorld, int contactCapacity);
+        
+        // Dtor
+        ~CollisionManager();
+        
+        void Clear() { contacts.Clear(); timings = CollisionTimings(); }
+        
+        // Number of contacts found in the last step
+        int ContactCount() const { return contacts.Count(); }
         
-        // Dtor - do nothing as no dynamic memory is used
-        ~CollisionManager() {}
+        // Caps the number of contacts in a step, contacts above the cap are
+        // ignored. Zero, the default, is no cap.
+        void SetMaxContacts(int count) { contacts.SetLimit(count); }
         
-        void Clear() { next = 0; }
+        // The cap on the number of contacts, zero if there is none
+        int GetMaxContacts() const { return contacts.Limit(); }
         
-        void IgnoreByType(int ignoreType) { ignore.push_back(ignoreType); }
+        // Most contacts in any one step, good for picking the capacity
+        int ContactHighWaterMark() const { return contacts.HighWaterMark(); }
+        
+        // Contacts ignored because of the cap
+        int DroppedContactCount() const { return contacts.Dropped(); }
+        
+        // Starts counting the high water mark and dropped contacts again
+        void ResetContactStats() { contacts.ResetStats(); }
+        
+        void IgnoreByType(int ignoreType);
                 
         void IgnoreByIDs(uint id0, uint id1);
+        
+        // Lets a pair of entities collide again
+        void UnignoreByIDs(uint id0, uint id1);
+        
+        // Sets if entities on the two layers collide, all layers collide
+        // with each other by default
+        void SetLayerCollision(uint layer0, uint layer1, bool collide);
+        
+        // Sets the mask of layers that this layer collides with
+        void SetLayerMask(uint layer, uint mask);
+        
+        // Checks if the two layers collide
+        bool LayersCollide(uint layer0, uint layer1) const
+        {
+            return (layerMasks[layer0] & (1u << layer1)) != 0;
+        }
+        
+        // Runs the narrowphase over the threads of the job system, null for
+        // the calling thread only (the default). The contacts come out in the
+        // same order for any number of threads.
+        void SetJobSystem(JobSystem* jobSystem) { jobs = jobSystem; }
+        
+        // Number of threads used for the narrowphase
+        int GetWorkerCount() const { return jobs ? jobs->Size() : 1; }
+        
+        // Switches to a different broadphase. The new one starts empty and
+        // picks up the entities on the next step.
+        void SetBroadphase(BroadphaseType type);
+        
+        // The kind of broadphase in use
+        BroadphaseType GetBroadphaseType() const { return broadphaseType; }
+        
+        // Access to the broadphase
+        Broadphase* GetBroadphase() const { return broadphase; }
                 
-        void AccumulateContacts(const std::list<Entity2D*>& entities);
+        void AccumulateContacts(const std::vector<Entity2D*>& entities);
+        
+        // Number of fast bodies that got pulled back in the last step
+        int SweptBodyCount() const { return sweptBodies; }
         
-        void AccumulateContacts(const std::list<Entity2D*>& entities,
+        // Builds the wall hierarchy, call whenever the walls change
+        void SetWalls(const std::vector<LineSegment>& walls) { wallTree.Build(walls); }
+        
+        // The wall hierarchy, also good for line of sight tests
+        const SegmentTree& GetWalls() const { return wallTree; }
+        
+        // Contacts with the walls, using the hierarchy from SetWalls. The
+        // hierarchy gets rebuilt if the number of walls doesn't match.
+        void AccumulateContacts(const std::vector<Entity2D*>& entities,
                                 const std::vector<LineSegment>&     walls);
 
+        // Iteratively moves the bodies apart
         void ResolveContacts();
         
+        // Impulse based, warm started from the cached contacts
         void ResolveVelocity();
+        
+        // Sets the max number of passes over the contacts. More is more
+        // accurate, especially for stacks and chains, but costs more.
+        void SetVelocityIterations(int iterations) { velocityIterations = iterations; }
+        void SetPositionIterations(int iterations) { positionIterations = iterations; }
+        
+        // Sets the residuals below which the solver can stop early
+        void SetVelocityTolerance(float tolerance) { velocityTolerance = tolerance; }
+        void SetPositionTolerance(float tolerance) { positionTolerance = tolerance; }
+        
+        // What the solver did in the last step
+        const SolverStats& GetSolverStats() const { return stats; }
+        
+        // Turns timing the phases on or off, off by default
+        void SetProfiling(bool enabled) { profiling = enabled; }
+        
+        // Time spent in each phase since the last Clear
+        const CollisionTimings& GetTimings() const { return timings; }
+        
+        // Sets how many frames a contact is remembered after it's gone
+        void SetContactLifetime(uint frames) { contactLifetime = frames; }
+        
+        // Turns warm starting on or off
+        void SetWarmStarting(bool enabled) { warmStarting = enabled; }
+        
+        // Sets the restitution for all contacts, one by default
+        void SetRestitution(float r) { restitution = r; }
+        
+        // Contacts approaching slower than this get no restitution, which
+        // keeps resting contacts from bouncing when warm started
+        void SetRestitutionThreshold(float velocity) { restitutionThreshold = velocity; }
+        
+        // Builds islands from the contacts, advances the sleep timers and
+        // puts to sleep the islands that have been resting long enough.
+        // Call after resolving the contacts.
+        void UpdateIslands(const std::vector<Entity2D*>& entities, float dt);
+        
+        // Turns sleeping on or off, off by default. Sleeping bodies are not
+        // moved by the physics, so games that move bodies by hand should wake
+        // them first (see DynamicEntity2D::Wake).
+        void SetSleeping(bool enabled) { sleepingEnabled = enabled; }
+        
+        // Sets the speed below which a body is resting
+        void SetSleepVelocity(float velocity) { sleepVelocity = velocity; }
+        
+        // Sets how long an island has to rest before going to sleep
+        void SetTimeToSleep(float time) { timeToSleep = time; }
+        
+        // Number of bodies that were sleeping in the last step
+        int SleepingBodyCount() const { return sleepingBodies; }
+        
+        // Forgets all cached contacts, needed if the IDs get reused
+        void ClearContactCache() { contactCache.clear(); }
+        
+        // Number of contacts remembered
+        int CachedContactCount() const { return (int)contactCache.size(); }
             
         void RaiseContactEvents();
     };
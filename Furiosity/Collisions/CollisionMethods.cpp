@@ -8,8 +8,18 @@
 
 
 #include "CollisionMethods.h"
+#include "SegmentTree.h"
 #include "Frmath.h"
 
+// Pick a vector unit for the batched tests
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define FURIOSITY_SSE2
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+    #include <arm_neon.h>
+    #define FURIOSITY_NEON
+#endif
+
 using namespace Furiosity;
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -38,13 +48,16 @@ void AddToInterval(float& left, float& right, float value)
         right = value;
 }
 
+// Projects the vertices on a direction
 void CreateInterval(float& left,
                     float& right,
                     const Vector2& dir, 
                     const Vector2* vertices,
                     int length)
 {
-    
+    left = right = dir.DotProduct(vertices[0]);
+    for(int i = 1; i < length; i++)
+        AddToInterval(left, right, dir.DotProduct(vertices[i]));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -64,6 +77,33 @@ float IntervalOverlap(float leftA, float rightA, float leftB, float rightB)
         return ovrlp0;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// One separating axis test between two convex sets of vertices. Keeps the
+// axis with the smallest overlap so far, pointing from the second set
+// towards the first. Returns false if the axis separates them.
+////////////////////////////////////////////////////////////////////////////////
+bool TestAxis(const Vector2& axis,
+              const Vector2* one, int countOne,
+              const Vector2* two, int countTwo,
+              float& penetration,
+              Vector2& normal)
+{
+    float leftA, rightA, leftB, rightB;
+    CreateInterval(leftA, rightA, axis, one, countOne);
+    CreateInterval(leftB, rightB, axis, two, countTwo);
+    
+    float overlap = IntervalOverlap(leftA, rightA, leftB, rightB);
+    if(overlap <= 0.0f)
+        return false;
+    
+    if(overlap < penetration)
+    {
+        penetration = overlap;
+        normal = (leftA + rightA > leftB + rightB) ? axis : axis * -1.0f;
+    }
+    return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Gets the closest point on a line to a circle
 ////////////////////////////////////////////////////////////////////////////////
@@ -116,7 +156,12 @@ bool Furiosity::CollisionShapeToLineSeg(CollisionShape const* shape,
         {
             const Disk& disk = *static_cast<Disk const*>(shape);
             return DiskToLineSeg(disk, *line, Matrix33::Identity, *contact);
-        }    
+        }
+        case COLLISION_SHAPE_BOX:
+        {
+            const Box& box = *static_cast<Box const*>(shape);
+            return BoxToLineSeg(box, *line, *contact);
+        }
         default:
             return false;
     }
@@ -159,7 +204,7 @@ bool Furiosity::ShapeToShape(CollisionShape const* shapeOne,
                         contact->ContactNormal *= -1.0f;
                         return true;
                     }
-                    break;
+                    return false;
                 }
                 
                 case COLLISION_SHAPE_POLYLINE:
@@ -199,8 +244,12 @@ bool Furiosity::ShapeToShape(CollisionShape const* shapeOne,
                 }
                     
                 case COLLISION_SHAPE_POLYLINE:
+                {
                     // box to line
-                    break;
+                    const Box& box          = *static_cast<Box const*>(shapeOne);
+                    const Polyline& line    = *static_cast<Polyline const*>(shapeTwo);
+                    return BoxToPolyline(box, line, *contact);
+                }
                     
                 default:
                     return false;
@@ -224,16 +273,25 @@ bool Furiosity::ShapeToShape(CollisionShape const* shapeOne,
                         contact->ContactNormal *= -1.0f;
                         return true;
                     }
-                    break;
+                    return false;
                 }
                     
                 case COLLISION_SHAPE_BOX:
+                {
                     // polyline to box
-                    break;
+                    const Box& box          = *static_cast<Box const*>(shapeTwo);
+                    const Polyline& line    = *static_cast<Polyline const*>(shapeOne);
+                    if( BoxToPolyline(box, line, *contact) )
+                    {
+                        contact->ContactNormal *= -1.0f;
+                        return true;
+                    }
+                    return false;
+                }
                     
                 case COLLISION_SHAPE_POLYLINE:
                     // polyline to polyline
-                    break;                    
+                    return false;
                     
                 default:
                     return false;
@@ -321,24 +379,322 @@ bool Furiosity::DiskToDisk(const Disk &diskOne,
 
 
 ////////////////////////////////////////////////////////////////////////////////
-// Just takes the first one for now
-// TODO: See if a more robust way is needed, like max penetration or such.
+// Writes the contacts for the lanes in the mask
+////////////////////////////////////////////////////////////////////////////////
+static inline int EmitLanes(int mask,
+                            const float* nx,
+                            const float* ny,
+                            const float* pen,
+                            int pair,
+                            Contact* contacts,
+                            int* hits)
+{
+    int written = 0;
+    for(int l = 0; l < 4; l++)
+    {
+        if(!(mask & (1 << l)))
+            continue;
+        
+        Contact& contact        = contacts[written];
+        contact.ContactNormal   = Vector2(nx[l], ny[l]);
+        contact.Penetration     = pen[l];
+        hits[written]           = pair + l;
+        written++;
+    }
+    return written;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Batched version of the disk to disk test. Pairs where any of the two is
+// not a disk should not be passed in here.
+////////////////////////////////////////////////////////////////////////////////
+int Furiosity::DiskToDiskBatch(const DiskBatch& disks,
+                               const int* first,
+                               const int* second,
+                               int count,
+                               Contact* contacts,
+                               int* hits)
+{
+    if(count <= 0)
+        return 0;
+    
+    const float* X = &disks.X[0];
+    const float* Y = &disks.Y[0];
+    const float* R = &disks.Radius[0];
+    
+    int written = 0;
+    int i = 0;
+    
+#if defined(FURIOSITY_SSE2)
+    
+    const __m128 zero   = _mm_setzero_ps();
+    const __m128 one    = _mm_set1_ps(1.0f);
+    
+    for(; i + 4 <= count; i += 4)
+    {
+        const int* a = first + i;
+        const int* b = second + i;
+        
+        // Gather
+        __m128 dx = _mm_sub_ps(_mm_setr_ps(X[a[0]], X[a[1]], X[a[2]], X[a[3]]),
+                               _mm_setr_ps(X[b[0]], X[b[1]], X[b[2]], X[b[3]]));
+        __m128 dy = _mm_sub_ps(_mm_setr_ps(Y[a[0]], Y[a[1]], Y[a[2]], Y[a[3]]),
+                               _mm_setr_ps(Y[b[0]], Y[b[1]], Y[b[2]], Y[b[3]]));
+        __m128 rsum = _mm_add_ps(_mm_setr_ps(R[a[0]], R[a[1]], R[a[2]], R[a[3]]),
+                                 _mm_setr_ps(R[b[0]], R[b[1]], R[b[2]], R[b[3]]));
+        
+        // Squared distance against the squared radii, most pairs end here
+        __m128 distSq   = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        int mask        = _mm_movemask_ps(_mm_cmplt_ps(distSq, _mm_mul_ps(rsum, rsum)));
+        if(!mask)
+            continue;
+        
+        // Normalize, but leave zero length normals as they are
+        __m128 dist     = _mm_sqrt_ps(distSq);
+        __m128 nonZero  = _mm_cmpgt_ps(dist, zero);
+        __m128 inv      = _mm_div_ps(one, dist);
+        inv             = _mm_or_ps(_mm_and_ps(nonZero, inv), _mm_andnot_ps(nonZero, one));
+        
+        float nx[4], ny[4], pen[4];
+        _mm_storeu_ps(nx,  _mm_mul_ps(dx, inv));
+        _mm_storeu_ps(ny,  _mm_mul_ps(dy, inv));
+        _mm_storeu_ps(pen, _mm_sub_ps(rsum, dist));
+        
+        written += EmitLanes(mask, nx, ny, pen, i, contacts + written, hits + written);
+    }
+    
+#elif defined(FURIOSITY_NEON)
+    
+    const float32x4_t zero  = vdupq_n_f32(0.0f);
+    const float32x4_t one   = vdupq_n_f32(1.0f);
+    const uint32x4_t  bits  = { 1, 2, 4, 8 };
+    
+    for(; i + 4 <= count; i += 4)
+    {
+        const int* a = first + i;
+        const int* b = second + i;
+        
+        // Gather
+        float ax[4] = { X[a[0]], X[a[1]], X[a[2]], X[a[3]] };
+        float bx[4] = { X[b[0]], X[b[1]], X[b[2]], X[b[3]] };
+        float ay[4] = { Y[a[0]], Y[a[1]], Y[a[2]], Y[a[3]] };
+        float by[4] = { Y[b[0]], Y[b[1]], Y[b[2]], Y[b[3]] };
+        float ar[4] = { R[a[0]], R[a[1]], R[a[2]], R[a[3]] };
+        float br[4] = { R[b[0]], R[b[1]], R[b[2]], R[b[3]] };
+        
+        float32x4_t dx      = vsubq_f32(vld1q_f32(ax), vld1q_f32(bx));
+        float32x4_t dy      = vsubq_f32(vld1q_f32(ay), vld1q_f32(by));
+        float32x4_t rsum    = vaddq_f32(vld1q_f32(ar), vld1q_f32(br));
+        
+        // Squared distance against the squared radii, most pairs end here
+        float32x4_t distSq  = vmlaq_f32(vmulq_f32(dx, dx), dy, dy);
+        uint32x4_t  inside  = vcltq_f32(distSq, vmulq_f32(rsum, rsum));
+        uint32x2_t  folded  = vpadd_u32(vget_low_u32(vandq_u32(inside, bits)),
+                                        vget_high_u32(vandq_u32(inside, bits)));
+        int mask            = (int)vget_lane_u32(vpadd_u32(folded, folded), 0);
+        if(!mask)
+            continue;
+        
+        // There is no sqrt on armv7, so refine the reciprocal sqrt estimate
+        float32x4_t inv = vrsqrteq_f32(distSq);
+        inv = vmulq_f32(inv, vrsqrtsq_f32(vmulq_f32(distSq, inv), inv));
+        inv = vmulq_f32(inv, vrsqrtsq_f32(vmulq_f32(distSq, inv), inv));
+        
+        // Normalize, but leave zero length normals as they are
+        uint32x4_t  nonZero = vcgtq_f32(distSq, zero);
+        inv                 = vbslq_f32(nonZero, inv, one);
+        float32x4_t dist    = vbslq_f32(nonZero, vmulq_f32(distSq, inv), zero);
+        
+        float nx[4], ny[4], pen[4];
+        vst1q_f32(nx,  vmulq_f32(dx, inv));
+        vst1q_f32(ny,  vmulq_f32(dy, inv));
+        vst1q_f32(pen, vsubq_f32(rsum, dist));
+        
+        written += EmitLanes(mask, nx, ny, pen, i, contacts + written, hits + written);
+    }
+    
+#endif
+    
+    // Whatever is left, or all of it without a vector unit
+    for(; i < count; i++)
+    {
+        int a = first[i];
+        int b = second[i];
+        
+        Vector2 normal(X[a] - X[b], Y[a] - Y[b]);
+        float rsum      = R[a] + R[b];
+        float distSq    = normal.SquareMagnitude();
+        if(distSq >= rsum * rsum)
+            continue;
+        
+        float dist = sqrtf(distSq);
+        normal.Normalize();
+        
+        Contact& contact        = contacts[written];
+        contact.ContactNormal   = normal;
+        contact.Penetration     = rsum - dist;
+        hits[written]           = i;
+        written++;
+    }
+    
+    return written;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Ray from + dir * t against a circle, only hits coming from the outside
+////////////////////////////////////////////////////////////////////////////////
+static bool RayToCircle(const Vector2& from,
+                        const Vector2& dir,
+                        const Vector2& center,
+                        float radius,
+                        float& t)
+{
+    Vector2 m   = from - center;
+    float c     = m.SquareMagnitude() - radius * radius;
+    float b     = m.DotProduct(dir);
+    
+    // Starts inside or moves away
+    if(c <= 0.0f || b >= 0.0f)
+        return false;
+    
+    float a     = dir.SquareMagnitude();
+    float disc  = b * b - a * c;
+    if(disc < 0.0f)
+        return false;
+    
+    t = (-b - sqrtf(disc)) / a;
+    return t <= 1.0f;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Swept disk to segment, the same as a ray against a capsule around it
+////////////////////////////////////////////////////////////////////////////////
+bool Furiosity::SweepDiskToLineSeg(const Vector2& from,
+                                   const Vector2& to,
+                                   float radius,
+                                   const LineSegment& line,
+                                   float& toi)
+{
+    Vector2 dir     = to - from;
+    Vector2 along   = line.B - line.A;
+    float lengthSq  = along.SquareMagnitude();
+    bool hit        = false;
+    toi             = 1.0f;
+    
+    // The sides
+    if(lengthSq > 0.0f)
+    {
+        Vector2 normal = along.Perpendicular() * (1.0f / sqrtf(lengthSq));
+        float s0 = (from - line.A).DotProduct(normal);
+        float s1 = (to - line.A).DotProduct(normal);
+        
+        // Crossing into the slab from either side
+        float t = -1.0f;
+        if(s0 > radius && s1 < radius)
+            t = (s0 - radius) / (s0 - s1);
+        else if(s0 < -radius && s1 > -radius)
+            t = (-radius - s0) / (s1 - s0);
+        
+        if(t >= 0.0f)
+        {
+            Vector2 p = from + dir * t;
+            float u = (p - line.A).DotProduct(along) / lengthSq;
+            if(u >= 0.0f && u <= 1.0f)
+            {
+                toi = t;
+                hit = true;
+            }
+        }
+    }
+    
+    // The ends
+    float t;
+    if(RayToCircle(from, dir, line.A, radius, t) && t < toi)
+    {
+        toi = t;
+        hit = true;
+    }
+    //
+    if(RayToCircle(from, dir, line.B, radius, t) && t < toi)
+    {
+        toi = t;
+        hit = true;
+    }
+    
+    return hit;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Swept disk to disk
+////////////////////////////////////////////////////////////////////////////////
+bool Furiosity::SweepDiskToDisk(const Vector2& from,
+                                const Vector2& to,
+                                float radius,
+                                const Vector2& center,
+                                float otherRadius,
+                                float& toi)
+{
+    return RayToCircle(from, to - from, center, radius + otherRadius, toi);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Takes the closest line, so the order the tree visits them in doesn't matter
 ////////////////////////////////////////////////////////////////////////////////
 bool Furiosity::DiskToPolyline(const Disk& disk,
                                const Polyline& polyline,
                                Contact& contact)
 {
-    for(int i = 0; i < polyline.lines.size(); i++)
+    Vector2 center  = disk.Transform->Translation();
+    AABB box        = AABB::FromDisk(center, disk.Radius);
+    if(!polyline.Bounds.Overlaps(box))
+        return false;
+    
+    // Compare squared distances, only the closest one needs a square root
+    float closestSq = disk.Radius * disk.Radius;
+    int closest     = -1;
+    Vector2 distVec;
+    //
+    polyline.Tree().Query(polyline.ToLocal(box), [&](int i)
     {
-        const LineSegment& line = polyline.lines[i];
+        const LineSegment& line = polyline.worldLines[i];
+        const Vector2& normal   = polyline.worldNormals[i];
         
+        // Project the center on the line, the direction comes from the normal
+        Vector2 along(-normal.y, normal.x);
+        float proj      = Clamp((center - line.A).DotProduct(along),
+                                0.0f,
+                                polyline.worldLengths[i]);
+        Vector2 offset  = center - (line.A + along * proj);
+        float distSq    = offset.SquareMagnitude();
         //
-        if(DiskToLineSeg(disk, line, *polyline.Transform, contact))
-            return true;
-    }
+        if(distSq < closestSq)
+        {
+            closestSq   = distSq;
+            closest     = i;
+            distVec     = offset;
+        }
+    });
     
     // No line intersected
-    return false;
+    if(closest == -1)
+        return false;
+    
+    float dist = sqrtf(closestSq);
+    if(dist <= 0)
+    {
+        // Exactly on the line, the side does not play a rolle
+        contact.ContactNormal   = polyline.worldNormals[closest];
+        contact.Penetration     = disk.Radius;
+    }
+    else
+    {
+        contact.ContactNormal   = distVec * (1.0f / dist);
+        contact.Penetration     = disk.Radius - dist;
+    }
+    
+    return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -346,10 +702,9 @@ bool Furiosity::DiskToPolyline(const Disk& disk,
 ////////////////////////////////////////////////////////////////////////////////
 bool Furiosity::BoxToDisk(const Box& box, const Disk& disk, Contact& contact)
 {
-    Matrix33 inv = box.Transform->Inverse();
-    //
-    Vector2 localCenter = disk.Transform->Translation();
-    inv.TransformVector2(localCenter);
+    // Into the space of the box with the cached axes
+    Vector2 offset = disk.Transform->Translation() - box.Transform->Translation();
+    Vector2 localCenter(offset.DotProduct(box.Axes[0]), offset.DotProduct(box.Axes[1]));
 
     float distx = Absf(localCenter.x);
     float disty = Absf(localCenter.y);
@@ -367,15 +722,15 @@ bool Furiosity::BoxToDisk(const Box& box, const Disk& disk, Contact& contact)
     {
         contact.Penetration = ovrlpy;
         contact.ContactNormal = localCenter.y <= 0 ?
-                                box.Transform->Up() :
-                                box.Transform->Up() * -1.0f;
+                                box.Axes[1] :
+                                box.Axes[1] * -1.0f;
     }
     else
     {
         contact.Penetration = ovrlpx;
         contact.ContactNormal = localCenter.x > 0 ?
-                                box.Transform->Right() * -1.0f:
-                                box.Transform->Right();
+                                box.Axes[0] * -1.0f:
+                                box.Axes[0];
     }
     return true;
 }
@@ -386,7 +741,78 @@ bool Furiosity::BoxToDisk(const Box& box, const Disk& disk, Contact& contact)
 ////////////////////////////////////////////////////////////////////////////////
 bool Furiosity::BoxToBox(const Box& boxOne, const Box& boxTwo, Contact& contact)
 {
-    return false;
+    if(!boxOne.Bounds.Overlaps(boxTwo.Bounds))
+        return false;
+    
+    float penetration = MAXFLOAT;
+    Vector2 normal;
+    
+    // Two axes per box are enough, the other two are the same lines
+    for(int i = 0; i < 2; i++)
+    {
+        if(!TestAxis(boxOne.Axes[i], boxOne.Corners, 4, boxTwo.Corners, 4, penetration, normal))
+            return false;
+        if(!TestAxis(boxTwo.Axes[i], boxOne.Corners, 4, boxTwo.Corners, 4, penetration, normal))
+            return false;
+    }
+    
+    contact.ContactNormal   = normal;
+    contact.Penetration     = penetration;
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Box to line segment
+////////////////////////////////////////////////////////////////////////////////
+bool Furiosity::BoxToLineSeg(const Box& box, const LineSegment& line, Contact& contact)
+{
+    if(!box.Bounds.Overlaps(AABB::FromSegment(line.A, line.B)))
+        return false;
+    
+    Vector2 ends[2] = { line.A, line.B };
+    float penetration = MAXFLOAT;
+    Vector2 normal;
+    
+    if(!TestAxis(box.Axes[0], box.Corners, 4, ends, 2, penetration, normal))
+        return false;
+    if(!TestAxis(box.Axes[1], box.Corners, 4, ends, 2, penetration, normal))
+        return false;
+    
+    // A segment with no length only has the box axes
+    Vector2 along = line.B - line.A;
+    if(along.SquareMagnitude() > 0.0f &&
+       !TestAxis(along.Perpendicular().Unit(), box.Corners, 4, ends, 2, penetration, normal))
+        return false;
+    
+    contact.ContactNormal   = normal;
+    contact.Penetration     = penetration;
+    return true;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Box to polyline
+////////////////////////////////////////////////////////////////////////////////
+bool Furiosity::BoxToPolyline(const Box& box, const Polyline& polyline, Contact& contact)
+{
+    if(!box.Bounds.Overlaps(polyline.Bounds))
+        return false;
+    
+    bool hit = false;
+    Contact segmentContact;
+    polyline.Tree().Query(polyline.ToLocal(box.Bounds), [&](int i)
+    {
+        if(BoxToLineSeg(box, polyline.worldLines[i], segmentContact) &&
+           (!hit || segmentContact.Penetration > contact.Penetration))
+        {
+            contact.ContactNormal   = segmentContact.ContactNormal;
+            contact.Penetration     = segmentContact.Penetration;
+            hit = true;
+        }
+    });
+    
+    return hit;
 }
 
 
@@ -9,11 +9,45 @@
 #ifndef COLLISION_METHODS_H
 #define COLLISION_METHODS_H
 
+#include <vector>
+
 #include "CollisionShapes.h"
 #include "Contact.h"
 
 namespace Furiosity
 {    
+    ///
+    /// DiskBatch
+    /// Disks laid out as a structure of arrays, so that the batched test can
+    /// load four of them at once. Bodies that are not disks still get a slot,
+    /// with a negative radius, so indices match the broadphase.
+    ///
+    struct DiskBatch
+    {
+        std::vector<float> X;
+        std::vector<float> Y;
+        std::vector<float> Radius;
+        
+        void Clear()
+        {
+            X.clear();
+            Y.clear();
+            Radius.clear();
+        }
+        
+        void Add(const Vector2& position, float radius)
+        {
+            X.push_back(position.x);
+            Y.push_back(position.y);
+            Radius.push_back(radius);
+        }
+        
+        bool IsDisk(int i) const { return Radius[i] >= 0.0f; }
+        
+        int Size() const { return (int)X.size(); }
+    };
+    
+    
     ///
     /// CollsionShapeToWall
     /// Entry point as it works for all shapes, hence all the pointers. Rest of the
@@ -56,6 +90,47 @@ namespace Furiosity
     bool DiskToDisk(const Disk& diskOne, const Disk& diskTwo, Contact& contact);
     
     
+    ///
+    /// Disk to disk, many at once
+    /// Tests the disk pairs (first[i], second[i]) four at a time, using SSE2 or
+    /// NEON when available. Only the normal and penetration get written, in the
+    /// same way as DiskToDisk. The contacts and hits need room for count
+    /// entries, hits gets the index of the pair for each contact written.
+    /// Returns the number of contacts.
+    ///
+    int DiskToDiskBatch(const DiskBatch& disks,
+                        const int* first,
+                        const int* second,
+                        int count,
+                        Contact* contacts,
+                        int* hits);
+    
+    
+    ///
+    /// Swept disk to line segment
+    /// Finds the first time in [0, 1] at which a disk moving from-to touches
+    /// the segment. A disk that is already touching at the start doesn't count,
+    /// as the regular tests take care of that.
+    ///
+    bool SweepDiskToLineSeg(const Vector2& from,
+                            const Vector2& to,
+                            float radius,
+                            const LineSegment& line,
+                            float& toi);
+    
+    
+    ///
+    /// Swept disk to disk
+    /// Same as above, against a disk that is not moving
+    ///
+    bool SweepDiskToDisk(const Vector2& from,
+                         const Vector2& to,
+                         float radius,
+                         const Vector2& center,
+                         float otherRadius,
+                         float& toi);
+    
+    
     ///
     /// Box to disk
     ///
@@ -64,8 +139,22 @@ namespace Furiosity
     
     ///
     /// Box to box
+    /// Separating axis test over the axes of both boxes
     ///
     bool BoxToBox(const Box& boxOne, const Box& boxTwo, Contact& contact);
+    
+    
+    ///
+    /// Box to a line segment in world space
+    ///
+    bool BoxToLineSeg(const Box& box, const LineSegment& line, Contact& contact);
+    
+    
+    ///
+    /// Box to polyline
+    /// Takes the deepest of the segments that touch the box
+    ///
+    bool BoxToPolyline(const Box& box, const Polyline& polyline, Contact& contact);
 }
 
 #endif
\ No newline at end of file
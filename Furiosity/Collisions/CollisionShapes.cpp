@@ -7,6 +7,7 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "CollisionShapes.h"
+#include "SegmentTree.h"
 
 #include "DebugDraw2D.h"
 
@@ -44,6 +45,34 @@ CollisionShape* CollisionShape::Create(const Matrix33 *transform,
     return 0;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// TransformChanged
+////////////////////////////////////////////////////////////////////////////////
+bool CollisionShape::TransformChanged()
+{
+    if(cached)
+    {
+        bool same = true;
+        for(int i = 0; i < 9 && same; i++)
+            same = cachedTransform.f[i] == Transform->f[i];
+        if(same)
+            return false;
+    }
+    
+    cachedTransform = *Transform;
+    cached = true;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// UpdateWorld
+////////////////////////////////////////////////////////////////////////////////
+void CollisionShape::UpdateWorld()
+{
+    // Good enough for disks
+    Bounds = AABB::FromDisk(Transform->Translation(), Radius);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //                         - POLYLINE -
 ////////////////////////////////////////////////////////////////////////////////
@@ -66,6 +95,79 @@ Polyline::Polyline(const Matrix33* transform, const std::vector<Vector2>& points
         lines.push_back( LineSegment(points[i], points[i + 1]) );
     // Connect the last one and the first one
     lines.push_back(LineSegment(points[i], points[0]));
+    
+    worldLines = lines;
+    worldNormals.resize(lines.size());
+    worldLengths.resize(lines.size());
+    
+    tree = new SegmentTree();
+    tree->Build(lines);
+    
+    // The tests read the cache, so it's never left empty
+    UpdateWorld();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Dtor
+////////////////////////////////////////////////////////////////////////////////
+Polyline::~Polyline()
+{
+    SafeDelete(tree);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// UpdateWorld
+////////////////////////////////////////////////////////////////////////////////
+void Polyline::UpdateWorld()
+{
+    if(!TransformChanged())
+        return;
+    
+    for(size_t i = 0; i < lines.size(); i++)
+    {
+        LineSegment& line = worldLines[i];
+        line.A = lines[i].A;
+        line.B = lines[i].B;
+        Transform->TransformVector2(line.A);
+        Transform->TransformVector2(line.B);
+        //
+        AABB box = AABB::FromSegment(line.A, line.B);
+        Bounds = i == 0 ? box : AABB::Merge(Bounds, box);
+        
+        // Only once per move, so the tests need no square roots
+        Vector2 along       = line.B - line.A;
+        float length        = along.Magnitude();
+        worldLengths[i]     = length;
+        worldNormals[i]     = length > 0.0f ?
+                              along.Perpendicular() * (1.0f / length) :
+                              Vector2(0.0f, 1.0f);
+    }
+    
+    inverse = Transform->Inverse();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ToLocal
+////////////////////////////////////////////////////////////////////////////////
+AABB Polyline::ToLocal(const AABB& box) const
+{
+    Vector2 corners[4] =
+    {
+        box.Min,
+        Vector2(box.Max.x, box.Min.y),
+        box.Max,
+        Vector2(box.Min.x, box.Max.y)
+    };
+    
+    AABB local;
+    for(int i = 0; i < 4; i++)
+    {
+        inverse.TransformVector2(corners[i]);
+        local = i == 0 ?
+                AABB(corners[i], corners[i]) :
+                AABB::Merge(local, AABB(corners[i], corners[i]));
+    }
+    return local;
 }
 
 
@@ -78,6 +180,35 @@ Box::Box(const Matrix33* transform, float width, float height)
     halfWidth = width * 0.5f;
     halfHeight = height * 0.5f;
     Radius = sqrtf( (halfWidth * halfWidth) + (halfHeight * halfHeight) );
+    
+    // The tests read the cache, so it's never left empty
+    UpdateWorld();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// UpdateWorld
+////////////////////////////////////////////////////////////////////////////////
+void Box::UpdateWorld()
+{
+    if(!TransformChanged())
+        return;
+    
+    // Same order as the debug render
+    Corners[0] = Vector2(halfWidth, -halfHeight);
+    Corners[1] = Vector2(halfWidth, halfHeight);
+    Corners[2] = Vector2(-halfWidth, halfHeight);
+    Corners[3] = Vector2(-halfWidth, -halfHeight);
+    //
+    for(int i = 0; i < 4; i++)
+    {
+        Transform->TransformVector2(Corners[i]);
+        Bounds = i == 0 ?
+                 AABB(Corners[0], Corners[0]) :
+                 AABB::Merge(Bounds, AABB(Corners[i], Corners[i]));
+    }
+    
+    Axes[0] = Transform->Right().Unit();
+    Axes[1] = Transform->Up().Unit();
 }
 
 
@@ -11,12 +11,16 @@
 
 #include "Frmath.h"
 #include "Color.h"
+#include "AABB.h"
 #include <cassert>
 
 #include <vector>
 
 namespace Furiosity
 {
+    // Fwd
+    class SegmentTree;
+    
     enum CollisionShapeEnum
     {
         COLLISION_SHAPE_NONE,
@@ -41,17 +45,35 @@ namespace Furiosity
         /// A bouding radius of the shape
         float       Radius;
         
+        /// World space bounds, as of the last UpdateWorld
+        AABB        Bounds;
+        
 #ifdef DEBUG
         /// Mechanics to render this shape
         virtual void DebugRender(Color c = Color::Red) {}
 #endif
         
     protected:
+        /// The transform the cached geometry was made with
+        Matrix33    cachedTransform;
+        
+        /// Set once there is something in the cache
+        bool        cached;
+        
         /// Protected ctor making this class abstract
         CollisionShape(const Matrix33* transform, float r, CollisionShapeEnum shape)
-            : Transform(transform), Radius(r), ShapeEnum(shape) {}
+            : Transform(transform), Radius(r), ShapeEnum(shape), cached(false) {}
+        
+        /// Checks if the transform changed since the last call
+        bool TransformChanged();
         
     public:
+        /// Brings the cached world space geometry up to date with the
+        /// transform. The collision tests read the cache, so call this after
+        /// moving and before testing. The collision manager does it once per
+        /// step for all bodies.
+        virtual void UpdateWorld();
+
         /// Virtual destructor. This makes this class "polymorphic" and allows
         /// usage of dynamic_cast.
         virtual ~CollisionShape() {}
@@ -110,7 +132,7 @@ namespace Furiosity
     
     
     ////////////////////////////////////////////////////////////////////////////////
-    // Place holder
+    // An oriented box, centered on the transform
     ////////////////////////////////////////////////////////////////////////////////
     class Box : public CollisionShape
     {
@@ -118,9 +140,18 @@ namespace Furiosity
         float halfWidth;
         float halfHeight;
         
+        /// Corners in world space, counter clockwise
+        Vector2 Corners[4];
+        
+        /// Unit axes in world space, along the width and along the height
+        Vector2 Axes[2];
+        
     public:
         Box(const Matrix33* transform, float width, float height);
         
+        /// Caches the corners, axes and bounds
+        virtual void UpdateWorld();
+        
 #ifdef DEBUG
         virtual void DebugRender(Color c = Color::Red);
 #endif
@@ -133,14 +164,49 @@ namespace Furiosity
     class Polyline : public CollisionShape
     {
     public:
+        /// The lines in local space, the hierarchy is built over these
+        /// so they should not change after construction
         std::vector<LineSegment> lines;
+        
+        /// The lines in world space
+        std::vector<LineSegment> worldLines;
+        
+        /// Unit normals of the world lines, on the right going from A to B
+        std::vector<Vector2> worldNormals;
+        
+        /// Lengths of the world lines
+        std::vector<float> worldLengths;
+        
+    protected:
+        /// Hierarchy over the local lines, built once
+        SegmentTree* tree;
+        
+        /// From world space to local space, as of the last UpdateWorld
+        Matrix33 inverse;
     
     public:
         Polyline(const Matrix33* transform, const std::vector<Vector2>& points);
+        
+        ~Polyline();
+        
+        /// Caches the world lines, normals, lengths and bounds
+        virtual void UpdateWorld();
+        
+        /// Hierarchy over the lines, the indices match the lines
+        const SegmentTree& Tree() const { return *tree; }
+        
+        /// Box in local space around a box in world space, for querying
+        /// the tree
+        AABB ToLocal(const AABB& box) const;
                 
 #ifdef DEBUG
         virtual void DebugRender(Color c = Color::Red);
 #endif
+        
+    private:
+        // Owns the tree
+        Polyline(const Polyline&);
+        Polyline& operator=(const Polyline&);
     };
 }
 
@@ -45,6 +45,16 @@ namespace Furiosity
         
         bool VelocityResloved;
         
+        /// Identifies the pair of bodies (or body and wall) across frames
+        uint64 ID;
+        
+        /// Impulse accumulated along the normal, carried over from the
+        /// previous frame to warm start the solver
+        float NormalImpulse;
+        
+        /// Separating velocity the solver is aiming for
+        float TargetVelocity;
+        
         /// Default init ctor
         ContactBase() : FirstBody(NULL),
                         SecondBody(NULL),
@@ -52,7 +62,10 @@ namespace Furiosity
                         ContactNormal(VectorT()),
                         Penetration(0.0f),
                         Resolved(false),
-                        VelocityResloved(false) {}
+                        VelocityResloved(false),
+                        ID(0),
+                        NormalImpulse(0.0f),
+                        TargetVelocity(0.0f) {}
         
         /// Creates a new contact among two dynamic bodies
         ContactBase(EntityT* firstBody,
@@ -66,7 +79,10 @@ namespace Furiosity
             ContactNormal(contactNormal),
             Penetration(penetration),
             Resolved(false),
-            VelocityResloved(false) {}
+            VelocityResloved(false),
+            ID(0),
+            NormalImpulse(0.0f),
+            TargetVelocity(0.0f) {}
         
         inline int Type()
         {
@@ -0,0 +1,146 @@
+////////////////////////////////////////////////////////////////////////////////
+//  ContactPool.h
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <cassert>
+
+// Local
+#include "Contact.h"
+
+namespace Furiosity
+{
+    ////////////////////////////////////////////////////////////////////////////////
+    // Contact Pool
+    // Storage for the contacts of a step. Contacts live in fixed size chunks
+    // that are never moved, so a pointer to a contact stays good until the
+    // pool is cleared, even if it grows in the meantime. Chunks are kept
+    // between steps, so once the pool has grown to fit the busiest step there
+    // are no more allocations. An optional limit caps the number of contacts,
+    // anything above it is counted as dropped.
+    ////////////////////////////////////////////////////////////////////////////////
+    class ContactPool
+    {
+    public:
+        /// Contacts per chunk, a power of two so indexing is a shift and a mask
+        enum { ChunkShift = 8, ChunkSize = 1 << ChunkShift };
+
+    protected:
+        /// The chunks, each holds ChunkSize contacts
+        std::vector<Contact*>   chunks;
+
+        /// Contacts in use
+        int                     count;
+
+        /// Most contacts ever in use at once
+        int                     highWaterMark;
+
+        /// Contacts that didn't fit under the limit since the last reset
+        int                     dropped;
+
+        /// Max number of contacts, zero for no limit
+        int                     limit;
+
+    public:
+        /// Ctor, room for at least this many contacts up front
+        explicit ContactPool(int capacity = 0) :   count(0),
+                                                   highWaterMark(0),
+                                                   dropped(0),
+                                                   limit(0)
+        {
+            Reserve(capacity);
+        }
+
+        /// Dtor
+        ~ContactPool()
+        {
+            for(Contact* chunk : chunks)
+                delete [] chunk;
+        }
+
+        /// Makes room for this many contacts without allocating later
+        void Reserve(int capacity)
+        {
+            while(Capacity() < capacity)
+                chunks.push_back(new Contact[ChunkSize]);
+        }
+
+        /// Hands out a new contact, or null if the limit was reached. The
+        /// contact still holds whatever was in it the last time it was used.
+        Contact* Allocate()
+        {
+            if(limit > 0 && count >= limit)
+            {
+                dropped++;
+                return 0;
+            }
+
+            if(count == Capacity())
+                chunks.push_back(new Contact[ChunkSize]);
+
+            Contact* contact = &chunks[count >> ChunkShift][count & (ChunkSize - 1)];
+            count++;
+            if(count > highWaterMark)
+                highWaterMark = count;
+            return contact;
+        }
+
+        /// Adds a copy of the contact, returns null if it was dropped
+        Contact* Add(const Contact& contact)
+        {
+            Contact* c = Allocate();
+            if(c)
+                *c = contact;
+            return c;
+        }
+
+        /// Lets go of all the contacts, keeping the memory
+        void Clear() { count = 0; }
+
+        /// Contact at index
+        Contact& operator[](int i)
+        {
+            assert(i >= 0 && i < count);
+            return chunks[i >> ChunkShift][i & (ChunkSize - 1)];
+        }
+
+        /// Contact at index
+        const Contact& operator[](int i) const
+        {
+            assert(i >= 0 && i < count);
+            return chunks[i >> ChunkShift][i & (ChunkSize - 1)];
+        }
+
+        /// Contacts in use
+        int Count() const { return count; }
+
+        /// Contacts that fit without allocating
+        int Capacity() const { return (int)chunks.size() * ChunkSize; }
+
+        /// Checks if the limit has been reached
+        bool Full() const { return limit > 0 && count >= limit; }
+
+        /// Caps the number of contacts, zero for no limit
+        void SetLimit(int l) { limit = l; }
+
+        /// The cap on the number of contacts, zero for no limit
+        int Limit() const { return limit; }
+
+        /// Most contacts ever in use at once
+        int HighWaterMark() const { return highWaterMark; }
+
+        /// Contacts that were dropped because of the limit
+        int Dropped() const { return dropped; }
+
+        /// Starts counting the high water mark and the drops from zero
+        void ResetStats() { highWaterMark = count; dropped = 0; }
+
+    private:
+        // Owns the chunks
+        ContactPool(const ContactPool&);
+        ContactPool& operator=(const ContactPool&);
+    };
+}
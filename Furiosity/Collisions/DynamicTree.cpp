@@ -0,0 +1,476 @@
+////////////////////////////////////////////////////////////////////////////////
+//  DynamicTree.cpp
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#include "DynamicTree.h"
+
+#include <algorithm>
+
+#include "DebugDraw2D.h"
+
+using namespace Furiosity;
+
+////////////////////////////////////////////////////////////////////////////////
+// Ctor
+////////////////////////////////////////////////////////////////////////////////
+DynamicTree::DynamicTree(float fatFactor, float displacementFactor) :
+    root(NullNode),
+    freeList(NullNode),
+    fatFactor(fatFactor),
+    displacementFactor(displacementFactor)
+{}
+
+////////////////////////////////////////////////////////////////////////////////
+// AllocateNode
+////////////////////////////////////////////////////////////////////////////////
+int DynamicTree::AllocateNode()
+{
+    int id;
+    if(freeList != NullNode)
+    {
+        id = freeList;
+        freeList = nodes[id].parent;
+    }
+    else
+    {
+        id = (int)nodes.size();
+        nodes.push_back(Node());
+    }
+
+    Node& node  = nodes[id];
+    node.entity = 0;
+    node.parent = NullNode;
+    node.child1 = NullNode;
+    node.child2 = NullNode;
+    node.height = 0;
+    return id;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// FreeNode
+////////////////////////////////////////////////////////////////////////////////
+void DynamicTree::FreeNode(int id)
+{
+    nodes[id].entity = 0;
+    nodes[id].parent = freeList;
+    nodes[id].height = -1;
+    freeList = id;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// CreateProxy
+////////////////////////////////////////////////////////////////////////////////
+int DynamicTree::CreateProxy(Entity2D* entity)
+{
+    int id = AllocateNode();
+    nodes[id].entity    = entity;
+    nodes[id].position  = entity->Position();
+    nodes[id].box       = FatBox(entity, Vector2(0.0f, 0.0f));
+    InsertLeaf(id);
+    moveBuffer.push_back(id);
+    return id;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// MoveProxy
+////////////////////////////////////////////////////////////////////////////////
+void DynamicTree::MoveProxy(int id)
+{
+    Entity2D* entity        = nodes[id].entity;
+    Vector2 position        = entity->Position();
+    Vector2 displacement    = position - nodes[id].position;
+    nodes[id].position      = position;
+
+    // Still inside the fat box, nothing to do
+    if(nodes[id].box.Contains(EntityBounds(entity)))
+        return;
+
+    RemoveLeaf(id);
+    nodes[id].box = FatBox(entity, displacement);
+    InsertLeaf(id);
+    moveBuffer.push_back(id);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// FatBox
+////////////////////////////////////////////////////////////////////////////////
+AABB DynamicTree::FatBox(Entity2D* entity, const Vector2& displacement) const
+{
+    AABB box = EntityBounds(entity).Fattened(entity->BoundingRadius() * fatFactor);
+
+    // Reach ahead only, the entity is not coming back
+    Vector2 d = displacement * displacementFactor;
+    if(d.x < 0.0f)  box.Min.x += d.x;
+    else            box.Max.x += d.x;
+    if(d.y < 0.0f)  box.Min.y += d.y;
+    else            box.Max.y += d.y;
+
+    return box;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// DestroyProxy
+////////////////////////////////////////////////////////////////////////////////
+void DynamicTree::DestroyProxy(int id)
+{
+    RemoveLeaf(id);
+    FreeNode(id);
+
+    if(id >= (int)destroyed.size())
+        destroyed.resize(id + 1, false);
+    destroyed[id] = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ClearProxies
+////////////////////////////////////////////////////////////////////////////////
+void DynamicTree::ClearProxies()
+{
+    nodes.clear();
+    root        = NullNode;
+    freeList    = NullNode;
+
+    moveBuffer.clear();
+    proxyPairs.clear();
+    pairKeys.Clear();
+    destroyed.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EndUpdate
+////////////////////////////////////////////////////////////////////////////////
+void DynamicTree::EndUpdate()
+{
+    // Drop the pairs that came apart or lost a leaf, in place and in order
+    size_t kept = 0;
+    for(size_t i = 0; i < proxyPairs.size(); i++)
+    {
+        int a = proxyPairs[i].first;
+        int b = proxyPairs[i].second;
+        bool gone = (a < (int)destroyed.size() && destroyed[a]) ||
+                    (b < (int)destroyed.size() && destroyed[b]);
+        if(gone || !nodes[a].box.Overlaps(nodes[b].box))
+            pairKeys.Remove(PairKey(a, b));
+        else
+            proxyPairs[kept++] = proxyPairs[i];
+    }
+    proxyPairs.resize(kept);
+    std::fill(destroyed.begin(), destroyed.end(), false);
+
+    // Only the leaves that moved can have new pairs
+    for(int id : moveBuffer)
+    {
+        // Might have been destroyed after it moved
+        if(nodes[id].height != 0)
+            continue;
+
+        QueryNodes(nodes[id].box, [&](int other)
+        {
+            if(other != id && pairKeys.Insert(PairKey(id, other)))
+                proxyPairs.push_back(std::make_pair(id, other));
+        });
+    }
+    moveBuffer.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// InsertLeaf
+////////////////////////////////////////////////////////////////////////////////
+void DynamicTree::InsertLeaf(int leaf)
+{
+    if(root == NullNode)
+    {
+        root = leaf;
+        nodes[root].parent = NullNode;
+        return;
+    }
+
+    // Find the best sibling by walking down the cheapest path
+    AABB leafBox = nodes[leaf].box;
+    int index = root;
+    while(!nodes[index].IsLeaf())
+    {
+        const Node& node = nodes[index];
+        int child1 = node.child1;
+        int child2 = node.child2;
+
+        float area          = node.box.Perimeter();
+        float combinedArea  = AABB::Merge(node.box, leafBox).Perimeter();
+
+        // Cost of creating a new parent for this node and the new leaf
+        float cost = 2.0f * combinedArea;
+
+        // Minimum cost of pushing the leaf further down the tree
+        float inheritanceCost = 2.0f * (combinedArea - area);
+
+        // Cost of descending into a child
+        float cost1 = AABB::Merge(leafBox, nodes[child1].box).Perimeter() + inheritanceCost;
+        if(!nodes[child1].IsLeaf())
+            cost1 -= nodes[child1].box.Perimeter();
+        //
+        float cost2 = AABB::Merge(leafBox, nodes[child2].box).Perimeter() + inheritanceCost;
+        if(!nodes[child2].IsLeaf())
+            cost2 -= nodes[child2].box.Perimeter();
+
+        // Descend according to the minimum cost
+        if(cost < cost1 && cost < cost2)
+            break;
+        //
+        index = cost1 < cost2 ? child1 : child2;
+    }
+
+    int sibling = index;
+
+    // Create a new parent, careful as this might move the nodes in memory
+    int oldParent = nodes[sibling].parent;
+    int newParent = AllocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].box    = AABB::Merge(leafBox, nodes[sibling].box);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].child1 = sibling;
+    nodes[newParent].child2 = leaf;
+    nodes[sibling].parent   = newParent;
+    nodes[leaf].parent      = newParent;
+
+    if(oldParent != NullNode)
+    {
+        if(nodes[oldParent].child1 == sibling)
+            nodes[oldParent].child1 = newParent;
+        else
+            nodes[oldParent].child2 = newParent;
+    }
+    else
+    {
+        // The sibling was the root
+        root = newParent;
+    }
+
+    // Walk back up the tree fixing heights and boxes
+    Refit(nodes[leaf].parent);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// RemoveLeaf
+////////////////////////////////////////////////////////////////////////////////
+void DynamicTree::RemoveLeaf(int leaf)
+{
+    if(leaf == root)
+    {
+        root = NullNode;
+        return;
+    }
+
+    int parent      = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling     = nodes[parent].child1 == leaf ?
+                        nodes[parent].child2 :
+                        nodes[parent].child1;
+
+    if(grandParent != NullNode)
+    {
+        // Destroy parent and connect sibling to grandparent
+        if(nodes[grandParent].child1 == parent)
+            nodes[grandParent].child1 = sibling;
+        else
+            nodes[grandParent].child2 = sibling;
+        nodes[sibling].parent = grandParent;
+        FreeNode(parent);
+
+        Refit(grandParent);
+    }
+    else
+    {
+        root = sibling;
+        nodes[sibling].parent = NullNode;
+        FreeNode(parent);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Refit
+////////////////////////////////////////////////////////////////////////////////
+void DynamicTree::Refit(int id)
+{
+    while(id != NullNode)
+    {
+        id = Balance(id);
+
+        Node& node  = nodes[id];
+        node.height = 1 + std::max(nodes[node.child1].height, nodes[node.child2].height);
+        node.box    = AABB::Merge(nodes[node.child1].box, nodes[node.child2].box);
+
+        id = node.parent;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Balance
+// If the node is imbalanced, the taller child gets rotated up. The layout is
+//
+//          A
+//       +--+--+
+//       B     C
+//      +-+   +-+
+//      D E   F G
+//
+////////////////////////////////////////////////////////////////////////////////
+int DynamicTree::Balance(int iA)
+{
+    Node& A = nodes[iA];
+    if(A.IsLeaf() || A.height < 2)
+        return iA;
+
+    int iB  = A.child1;
+    int iC  = A.child2;
+    Node& B = nodes[iB];
+    Node& C = nodes[iC];
+
+    int balance = C.height - B.height;
+
+    // Rotate C up
+    if(balance > 1)
+    {
+        int iF  = C.child1;
+        int iG  = C.child2;
+        Node& F = nodes[iF];
+        Node& G = nodes[iG];
+
+        // Swap A and C
+        C.child1 = iA;
+        C.parent = A.parent;
+        A.parent = iC;
+
+        // A's old parent should point to C
+        if(C.parent != NullNode)
+        {
+            if(nodes[C.parent].child1 == iA)
+                nodes[C.parent].child1 = iC;
+            else
+                nodes[C.parent].child2 = iC;
+        }
+        else
+            root = iC;
+
+        // Rotate
+        if(F.height > G.height)
+        {
+            C.child2 = iF;
+            A.child2 = iG;
+            G.parent = iA;
+            A.box    = AABB::Merge(B.box, G.box);
+            C.box    = AABB::Merge(A.box, F.box);
+            A.height = 1 + std::max(B.height, G.height);
+            C.height = 1 + std::max(A.height, F.height);
+        }
+        else
+        {
+            C.child2 = iG;
+            A.child2 = iF;
+            F.parent = iA;
+            A.box    = AABB::Merge(B.box, F.box);
+            C.box    = AABB::Merge(A.box, G.box);
+            A.height = 1 + std::max(B.height, F.height);
+            C.height = 1 + std::max(A.height, G.height);
+        }
+
+        return iC;
+    }
+
+    // Rotate B up
+    if(balance < -1)
+    {
+        int iD  = B.child1;
+        int iE  = B.child2;
+        Node& D = nodes[iD];
+        Node& E = nodes[iE];
+
+        // Swap A and B
+        B.child1 = iA;
+        B.parent = A.parent;
+        A.parent = iB;
+
+        // A's old parent should point to B
+        if(B.parent != NullNode)
+        {
+            if(nodes[B.parent].child1 == iA)
+                nodes[B.parent].child1 = iB;
+            else
+                nodes[B.parent].child2 = iB;
+        }
+        else
+            root = iB;
+
+        // Rotate
+        if(D.height > E.height)
+        {
+            B.child2 = iD;
+            A.child1 = iE;
+            E.parent = iA;
+            A.box    = AABB::Merge(C.box, E.box);
+            B.box    = AABB::Merge(A.box, D.box);
+            A.height = 1 + std::max(C.height, E.height);
+            B.height = 1 + std::max(A.height, D.height);
+        }
+        else
+        {
+            B.child2 = iE;
+            A.child1 = iD;
+            D.parent = iA;
+            A.box    = AABB::Merge(C.box, D.box);
+            B.box    = AABB::Merge(A.box, E.box);
+            A.height = 1 + std::max(C.height, D.height);
+            B.height = 1 + std::max(A.height, E.height);
+        }
+
+        return iB;
+    }
+
+    return iA;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// CollectPairs
+////////////////////////////////////////////////////////////////////////////////
+void DynamicTree::CollectPairs(std::vector<BroadphasePair>& pairs) const
+{
+    // The fat boxes overlap, check the tight ones as well
+    for(const std::pair<int, int>& pair : proxyPairs)
+    {
+        if(EntityBounds(nodes[pair.first].entity).Overlaps(EntityBounds(nodes[pair.second].entity)))
+            ReportPair(pairs, pair.first, pair.second);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Query
+////////////////////////////////////////////////////////////////////////////////
+void DynamicTree::Query(const AABB& box, std::vector<Entity2D*>& result) const
+{
+    // The leaves are fat, so check the tight box as well
+    QueryNodes(box, [&](int id)
+    {
+        if(EntityBounds(nodes[id].entity).Overlaps(box))
+            result.push_back(nodes[id].entity);
+    });
+}
+
+
+#ifdef DEBUG
+////////////////////////////////////////////////////////////////////////////////
+// DebugRender
+////////////////////////////////////////////////////////////////////////////////
+void DynamicTree::DebugRender()
+{
+    for(const Node& node : nodes)
+    {
+        if(node.height < 0)
+            continue;
+        gDebugDraw2D.AddRectangle(node.box.Min,
+                                  node.box.Max,
+                                  node.IsLeaf() ? Color::Grey : Color::White);
+    }
+}
+#endif
+
+// end
@@ -0,0 +1,271 @@
+////////////////////////////////////////////////////////////////////////////////
+//  DynamicTree.h
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <list>
+
+// Local
+#include "Broadphase.h"
+#include "AABB.h"
+#include "PairSet.h"
+
+namespace Furiosity
+{
+    ////////////////////////////////////////////////////////////////////////////////
+    // Dynamic Tree
+    // A bounding volume hierarchy of axis aligned boxes, built incrementally.
+    // Leaves hold fattened boxes, so an entity only gets reinserted once it
+    // moves out of its fat box. Inserting walks down picking the cheapest
+    // sibling by perimeter and every node on the way back up gets refit and
+    // rebalanced with tree rotations. There is no cell size to tune, so it
+    // handles entities of very different sizes well.
+    //
+    // Fat boxes are stretched along the last move, so a fast entity keeps its
+    // leaf for a few frames as well. Pairs are kept between updates and only
+    // the leaves that got reinserted query the tree for new ones.
+    ////////////////////////////////////////////////////////////////////////////////
+    class DynamicTree : public Broadphase
+    {
+    public:
+        /// Index used for no node
+        enum { NullNode = -1 };
+
+        /// Size of the traversal stack, the tree is kept balanced so this is plenty
+        enum { StackSize = 256 };
+
+    protected:
+        /// A node in the tree
+        struct Node
+        {
+            /// Fat box for leaves, union of the children otherwise
+            AABB        box;
+
+            /// Entity for leaves, null for inner nodes
+            Entity2D*   entity;
+
+            /// Parent node, the free list uses this as next
+            int         parent;
+
+            /// Children, null for leaves
+            int         child1;
+            int         child2;
+
+            /// Leaves have height zero, free nodes -1
+            int         height;
+
+            /// Where the entity was at the last update, leaves only
+            Vector2     position;
+
+            bool IsLeaf() const { return child1 == NullNode; }
+        };
+
+        /// All the nodes, leaf indices are used as proxy handles
+        std::vector<Node>   nodes;
+
+        /// Root of the tree
+        int                 root;
+
+        /// Head of the free node list
+        int                 freeList;
+
+        /// Fat boxes are grown by this fraction of the bounding radius
+        float               fatFactor;
+
+        /// Fat boxes are stretched by this many times the last move
+        float               displacementFactor;
+
+        /// Leaves that were inserted or reinserted since the last update
+        std::vector<int>    moveBuffer;
+
+        /// Leaves with fat boxes that overlap, proxy handles are stored in
+        /// the order they were found
+        std::vector<std::pair<int, int>>    proxyPairs;
+
+        /// Keys of the pairs, so a pair is only stored once
+        PairSet             pairKeys;
+
+        /// Flags the leaves that were destroyed since the last update, so
+        /// their pairs get dropped even if the node is reused
+        std::vector<bool>   destroyed;
+
+    public:
+        /// Ctor
+        DynamicTree(float fatFactor = 0.25f, float displacementFactor = 4.0f);
+
+        /// Sets how much the leaves are fattened, as a fraction of the radius.
+        /// Bigger values mean fewer reinserts, but more false pairs.
+        void SetFatFactor(float factor) { fatFactor = factor; }
+
+        /// Sets how far ahead the leaves reach along the last move, in moves
+        void SetDisplacementFactor(float factor) { displacementFactor = factor; }
+
+        /// Number of pairs with overlapping fat boxes
+        int PairCount() const { return (int)proxyPairs.size(); }
+
+        /// Height of the tree, useful to see if it's balanced
+        int Height() const { return root == NullNode ? 0 : nodes[root].height; }
+
+        /// Calls visitor(Entity2D*) for each entity with a fat box that overlaps
+        /// the given box. No memory is allocated.
+        template<class Visitor>
+        void VisitBox(const AABB& box, const Visitor& visitor) const;
+
+        /// Calls visitor(Entity2D*, float maxFraction) for each entity with a fat
+        /// box the segment passes through. The visitor returns the new max
+        /// fraction along the segment, so it can clip the ray on a hit, return 0
+        /// to stop or maxFraction to keep going.
+        template<class Visitor>
+        void RayCast(const Vector2& from, const Vector2& to, const Visitor& visitor) const;
+
+        /// Broadphase override
+        virtual void CollectPairs(std::vector<BroadphasePair>& pairs) const;
+
+        /// Broadphase override
+        virtual void Query(const AABB& box, std::vector<Entity2D*>& result) const;
+
+#ifdef DEBUG
+        virtual void DebugRender();
+#endif
+
+    protected:
+        /// Inserts a new leaf
+        virtual int  CreateProxy(Entity2D* entity);
+
+        /// Reinserts the leaf only if it left its fat box
+        virtual void MoveProxy(int id);
+
+        /// Removes the leaf
+        virtual void DestroyProxy(int id);
+
+        /// Drops everything
+        virtual void ClearProxies();
+
+        /// Drops the pairs that came apart and finds the new ones
+        virtual void EndUpdate();
+
+        /// Fat box for a leaf, stretched along the displacement
+        AABB FatBox(Entity2D* entity, const Vector2& displacement) const;
+
+        /// Key of a pair of proxies, in either order
+        static uint64 PairKey(int proxy0, int proxy1)
+        {
+            if(proxy0 > proxy1)
+                std::swap(proxy0, proxy1);
+            // Plus one so that the key is never zero
+            return ((uint64)proxy0 << 32) | (uint64)(proxy1 + 1);
+        }
+
+        /// Gets a node from the free list or grows the pool
+        int AllocateNode();
+
+        /// Returns a node to the free list
+        void FreeNode(int id);
+
+        /// Links a leaf in the tree
+        void InsertLeaf(int leaf);
+
+        /// Unlinks a leaf from the tree
+        void RemoveLeaf(int leaf);
+
+        /// Refits and rebalances all nodes from this one up to the root
+        void Refit(int id);
+
+        /// Performs a left or right rotation if node is imbalanced.
+        /// Returns the new root of the subtree.
+        int Balance(int id);
+
+        /// Visits the indices of all leaves overlapping the box
+        template<class Visitor>
+        void QueryNodes(const AABB& box, const Visitor& visitor) const;
+    };
+
+
+    ////////////////////////////////////////////////////////////////////////////////
+    //
+    //                            - Implemetation -
+    //
+    ////////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // QueryNodes
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class Visitor>
+    void DynamicTree::QueryNodes(const AABB& box, const Visitor& visitor) const
+    {
+        int stack[StackSize];
+        int count = 0;
+        stack[count++] = root;
+
+        while(count > 0)
+        {
+            int id = stack[--count];
+            if(id == NullNode)
+                continue;
+
+            const Node& node = nodes[id];
+            if(!node.box.Overlaps(box))
+                continue;
+
+            if(node.IsLeaf())
+            {
+                visitor(id);
+            }
+            else
+            {
+                assert(count + 2 <= StackSize);
+                stack[count++] = node.child1;
+                stack[count++] = node.child2;
+            }
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // VisitBox
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class Visitor>
+    void DynamicTree::VisitBox(const AABB& box, const Visitor& visitor) const
+    {
+        QueryNodes(box, [&](int id) { visitor(nodes[id].entity); });
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // RayCast
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class Visitor>
+    void DynamicTree::RayCast(const Vector2& from, const Vector2& to, const Visitor& visitor) const
+    {
+        float maxFraction = 1.0f;
+
+        int stack[StackSize];
+        int count = 0;
+        stack[count++] = root;
+
+        while(count > 0)
+        {
+            int id = stack[--count];
+            if(id == NullNode)
+                continue;
+
+            const Node& node = nodes[id];
+            if(!node.box.Raycast(from, to, maxFraction))
+                continue;
+
+            if(node.IsLeaf())
+            {
+                maxFraction = visitor(node.entity, maxFraction);
+                if(maxFraction <= 0.0f)
+                    return;
+            }
+            else
+            {
+                assert(count + 2 <= StackSize);
+                stack[count++] = node.child1;
+                stack[count++] = node.child2;
+            }
+        }
+    }
+}
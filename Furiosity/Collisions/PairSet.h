@@ -0,0 +1,138 @@
+////////////////////////////////////////////////////////////////////////////////
+//  PairSet.h
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+// Local
+#include "Defines.h"
+
+namespace Furiosity
+{
+    ////////////////////////////////////////////////////////////////////////////////
+    // Pair Set
+    // A set of 64 bit pair IDs with open addressing and linear probing, so a
+    // lookup is a hash and a short scan over one array. Zero is used to mark
+    // empty slots, so it can't be stored (pair IDs of valid entities are never
+    // zero). Removing shifts the following entries back, so there are no
+    // tombstones and lookups stay short.
+    ////////////////////////////////////////////////////////////////////////////////
+    class PairSet
+    {
+    protected:
+        /// Slots, size is always a power of two
+        std::vector<uint64> slots;
+
+        /// Number of keys stored
+        int                 count;
+
+    public:
+        /// Ctor
+        PairSet() : slots(16, 0), count(0) {}
+
+        /// Number of pairs in the set
+        int Size() const { return count; }
+
+        /// Checks if the pair is in the set
+        bool Contains(uint64 key) const
+        {
+            if(count == 0)
+                return false;
+
+            uint mask = (uint)slots.size() - 1;
+            for(uint i = Hash(key) & mask; ; i = (i + 1) & mask)
+            {
+                if(slots[i] == key)
+                    return true;
+                if(slots[i] == 0)
+                    return false;
+            }
+        }
+
+        /// Adds a pair, returns false if it was already there
+        bool Insert(uint64 key)
+        {
+            assert(key != 0);
+
+            // Keep at most half full
+            if(2 * (count + 1) > (int)slots.size())
+                Grow();
+
+            uint mask = (uint)slots.size() - 1;
+            uint i = Hash(key) & mask;
+            for(; slots[i] != 0; i = (i + 1) & mask)
+                if(slots[i] == key)
+                    return false;
+
+            slots[i] = key;
+            count++;
+            return true;
+        }
+
+        /// Removes a pair, returns false if it wasn't there
+        bool Remove(uint64 key)
+        {
+            uint mask = (uint)slots.size() - 1;
+            uint i = Hash(key) & mask;
+            for(; slots[i] != key; i = (i + 1) & mask)
+                if(slots[i] == 0)
+                    return false;
+
+            // Shift back any entries that probed past this slot
+            uint j = i;
+            for(;;)
+            {
+                j = (j + 1) & mask;
+                if(slots[j] == 0)
+                    break;
+
+                // Leave it if its home slot is cyclically in (i, j]
+                uint home = Hash(slots[j]) & mask;
+                if(i <= j ? (i < home && home <= j) : (i < home || home <= j))
+                    continue;
+
+                slots[i] = slots[j];
+                i = j;
+            }
+
+            slots[i] = 0;
+            count--;
+            return true;
+        }
+
+        /// Removes all pairs
+        void Clear()
+        {
+            std::fill(slots.begin(), slots.end(), 0);
+            count = 0;
+        }
+
+    protected:
+        /// Mixes all the bits of the key, as the IDs are mostly small numbers
+        static uint Hash(uint64 key)
+        {
+            key ^= key >> 33;
+            key *= 0xff51afd7ed558ccdULL;
+            key ^= key >> 33;
+            key *= 0xc4ceb9fe1a85ec53ULL;
+            key ^= key >> 33;
+            return (uint)key;
+        }
+
+        /// Doubles the number of slots and reinserts everything
+        void Grow()
+        {
+            std::vector<uint64> old(slots.size() * 2, 0);
+            old.swap(slots);
+            count = 0;
+            for(uint64 key : old)
+                if(key != 0)
+                    Insert(key);
+        }
+    };
+}
@@ -0,0 +1,170 @@
+////////////////////////////////////////////////////////////////////////////////
+//  SegmentTree.cpp
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#include "SegmentTree.h"
+
+#include <algorithm>
+
+#include "DebugDraw2D.h"
+
+using namespace Furiosity;
+
+////////////////////////////////////////////////////////////////////////////////
+// Build
+////////////////////////////////////////////////////////////////////////////////
+void SegmentTree::Build(const std::vector<LineSegment>& segs)
+{
+    Clear();
+    if(segs.empty())
+        return;
+
+    segments = segs;
+    indices.resize(segments.size());
+    for(int i = 0; i < (int)indices.size(); i++)
+        indices[i] = i;
+
+    // A full binary tree over the leaves has less than two nodes per leaf
+    nodes.reserve(2 * (segments.size() / LeafSize + 1));
+    BuildNode(0, (int)indices.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Clear
+////////////////////////////////////////////////////////////////////////////////
+void SegmentTree::Clear()
+{
+    nodes.clear();
+    segments.clear();
+    indices.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// BuildNode
+////////////////////////////////////////////////////////////////////////////////
+int SegmentTree::BuildNode(int start, int count)
+{
+    int id = (int)nodes.size();
+    nodes.push_back(Node());
+
+    // Bounds of the segments and of their centers
+    const LineSegment& first = segments[indices[start]];
+    AABB box        = AABB::FromSegment(first.A, first.B);
+    AABB centers    = AABB(box.Center(), box.Center());
+    for(int i = start + 1; i < start + count; i++)
+    {
+        const LineSegment& s = segments[indices[i]];
+        AABB sbox   = AABB::FromSegment(s.A, s.B);
+        box         = AABB::Merge(box, sbox);
+        centers     = AABB::Merge(centers, AABB(sbox.Center(), sbox.Center()));
+    }
+
+    nodes[id].box       = box;
+    nodes[id].child1    = NullNode;
+    nodes[id].child2    = NullNode;
+    nodes[id].start     = start;
+    nodes[id].count     = count;
+
+    if(count <= LeafSize)
+        return id;
+
+    // Split at the median along the longest axis
+    Vector2 size    = centers.Max - centers.Min;
+    int axis        = size.x >= size.y ? 0 : 1;
+    int half        = count / 2;
+    //
+    std::nth_element(indices.begin() + start,
+                     indices.begin() + start + half,
+                     indices.begin() + start + count,
+                     [this, axis](int a, int b)
+                     {
+                         const LineSegment& sa = segments[a];
+                         const LineSegment& sb = segments[b];
+                         return sa.A[axis] + sa.B[axis] < sb.A[axis] + sb.B[axis];
+                     });
+
+    // Careful as this might move the nodes in memory
+    int child1 = BuildNode(start, half);
+    int child2 = BuildNode(start + half, count - half);
+    nodes[id].child1    = child1;
+    nodes[id].child2    = child2;
+    nodes[id].count     = 0;
+    return id;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// RayCast
+////////////////////////////////////////////////////////////////////////////////
+bool SegmentTree::RayCast(const Vector2& from,
+                          const Vector2& to,
+                          float& fraction,
+                          int& segment) const
+{
+    segment = -1;
+    fraction = 1.0f;
+    if(nodes.empty())
+        return false;
+
+    Vector2 d = to - from;
+
+    int stack[StackSize];
+    int count = 0;
+    stack[count++] = 0;
+
+    while(count > 0)
+    {
+        const Node& node = nodes[stack[--count]];
+
+        // Only look for hits closer than what was found so far
+        if(!node.box.Raycast(from, to, fraction))
+            continue;
+
+        if(node.IsLeaf())
+        {
+            for(int i = node.start; i < node.start + node.count; i++)
+            {
+                const LineSegment& s = segments[indices[i]];
+                Vector2 e       = s.B - s.A;
+                Vector2 f       = s.A - from;
+                float denom     = d.x * e.y - d.y * e.x;
+
+                // Parallel segments don't count as a hit
+                if(denom == 0.0f)
+                    continue;
+
+                float t = (f.x * e.y - f.y * e.x) / denom;
+                float u = (f.x * d.y - f.y * d.x) / denom;
+                if(t >= 0.0f && t <= fraction && u >= 0.0f && u <= 1.0f)
+                {
+                    fraction = t;
+                    segment  = indices[i];
+                }
+            }
+        }
+        else
+        {
+            assert(count + 2 <= StackSize);
+            stack[count++] = node.child1;
+            stack[count++] = node.child2;
+        }
+    }
+
+    return segment != -1;
+}
+
+
+#ifdef DEBUG
+////////////////////////////////////////////////////////////////////////////////
+// DebugRender
+////////////////////////////////////////////////////////////////////////////////
+void SegmentTree::DebugRender()
+{
+    for(const Node& node : nodes)
+        gDebugDraw2D.AddRectangle(node.box.Min,
+                                  node.box.Max,
+                                  node.IsLeaf() ? Color::Grey : Color::White);
+}
+#endif
+
+// end
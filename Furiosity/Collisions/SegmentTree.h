@@ -0,0 +1,151 @@
+////////////////////////////////////////////////////////////////////////////////
+//  SegmentTree.h
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <cassert>
+
+// Local
+#include "CollisionShapes.h"
+#include "AABB.h"
+
+namespace Furiosity
+{
+    ////////////////////////////////////////////////////////////////////////////////
+    // Segment Tree
+    // A static bounding volume hierarchy over line segments, for geometry that
+    // doesn't move like the level walls. It gets built top down in one go by
+    // splitting at the median along the longest axis, so it's balanced and
+    // stored flat. Rebuild it whenever the segments change.
+    ////////////////////////////////////////////////////////////////////////////////
+    class SegmentTree
+    {
+    public:
+        /// Index used for no node
+        enum { NullNode = -1 };
+
+        /// Max segments in a leaf
+        enum { LeafSize = 4 };
+
+        /// Size of the traversal stack, the tree is balanced so this is plenty
+        enum { StackSize = 64 };
+
+    protected:
+        /// A node in the tree
+        struct Node
+        {
+            /// Box around all the segments below
+            AABB    box;
+
+            /// Children, null for leaves
+            int     child1;
+            int     child2;
+
+            /// Range in the indices, only used by leaves
+            int     start;
+            int     count;
+
+            bool IsLeaf() const { return child1 == NullNode; }
+        };
+
+        /// All the nodes, the root is the first one
+        std::vector<Node>           nodes;
+
+        /// Copy of the segments in the order they were given
+        std::vector<LineSegment>    segments;
+
+        /// Segment indices, grouped by leaf
+        std::vector<int>            indices;
+
+    public:
+        /// Builds the tree over the segments, dropping the old one
+        void Build(const std::vector<LineSegment>& segments);
+
+        /// Drops the tree
+        void Clear();
+
+        /// Number of segments in the tree
+        int Count() const { return (int)segments.size(); }
+
+        /// Gets a segment by the index it had when building
+        const LineSegment& Segment(int i) const { return segments[i]; }
+
+        /// Calls visitor(int) with the index of each segment with a bounding
+        /// box that overlaps the given box. No memory is allocated.
+        template<class Visitor>
+        void Query(const AABB& box, const Visitor& visitor) const;
+
+        /// Finds the first segment hit by the segment going from-to.
+        ///
+        /// @param fraction Where along the ray the hit is, from 0 to 1
+        /// @param segment Index of the segment hit
+        /// @return True if something was hit
+        bool RayCast(const Vector2& from,
+                     const Vector2& to,
+                     float& fraction,
+                     int& segment) const;
+
+        /// Checks if anything is in the way between the two points
+        bool LineOfSight(const Vector2& from, const Vector2& to) const
+        {
+            float fraction;
+            int segment;
+            return !RayCast(from, to, fraction, segment);
+        }
+
+#ifdef DEBUG
+        void DebugRender();
+#endif
+
+    protected:
+        /// Recursively creates the nodes for a range of the indices
+        int BuildNode(int start, int count);
+    };
+
+
+    ////////////////////////////////////////////////////////////////////////////////
+    //
+    //                            - Implemetation -
+    //
+    ////////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Query
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class Visitor>
+    void SegmentTree::Query(const AABB& box, const Visitor& visitor) const
+    {
+        if(nodes.empty())
+            return;
+
+        int stack[StackSize];
+        int count = 0;
+        stack[count++] = 0;
+
+        while(count > 0)
+        {
+            const Node& node = nodes[stack[--count]];
+            if(!node.box.Overlaps(box))
+                continue;
+
+            if(node.IsLeaf())
+            {
+                for(int i = node.start; i < node.start + node.count; i++)
+                {
+                    const LineSegment& s = segments[indices[i]];
+                    if(AABB::FromSegment(s.A, s.B).Overlaps(box))
+                        visitor(indices[i]);
+                }
+            }
+            else
+            {
+                assert(count + 2 <= StackSize);
+                stack[count++] = node.child1;
+                stack[count++] = node.child2;
+            }
+        }
+    }
+}
@@ -0,0 +1,284 @@
+////////////////////////////////////////////////////////////////////////////////
+//  SpatialHash.cpp
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#include "SpatialHash.h"
+
+#include "DebugDraw2D.h"
+
+using namespace Furiosity;
+
+////////////////////////////////////////////////////////////////////////////////
+// Ctor
+////////////////////////////////////////////////////////////////////////////////
+SpatialHash::SpatialHash(float cellSize, int bucketCount) :
+    freeList(-1),
+    cellSize(0.0f),
+    invCellSize(0.0f),
+    count(0)
+{
+    // Round up to a power of two so hashing can use a mask
+    int size = 1;
+    while(size < bucketCount)
+        size <<= 1;
+    buckets.resize(size, -1);
+
+    if(cellSize > 0.0f)
+        SetCellSize(cellSize);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// BeginUpdate
+////////////////////////////////////////////////////////////////////////////////
+bool SpatialHash::BeginUpdate(const std::vector<Entity2D*>& entities)
+{
+    if(cellSize <= 0.0f)
+        PickCellSize(entities);
+
+    // Nothing to put in the hash yet
+    return cellSize > 0.0f;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EndUpdate
+////////////////////////////////////////////////////////////////////////////////
+void SpatialHash::EndUpdate()
+{
+    // Keep the chains short
+    if(count > 2 * (int)buckets.size())
+        Rehash((int)buckets.size() * 4);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// CreateProxy
+////////////////////////////////////////////////////////////////////////////////
+int SpatialHash::CreateProxy(Entity2D* entity)
+{
+    // Grab a proxy, recycle if possible
+    int id;
+    if(freeList != -1)
+    {
+        id = freeList;
+        freeList = proxies[id].next;
+    }
+    else
+    {
+        id = (int)proxies.size();
+        proxies.push_back(Proxy());
+    }
+
+    proxies[id].entity = entity;
+    proxies[id].bounds = EntityBounds(entity);
+    Link(id);
+    return id;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// DestroyProxy
+////////////////////////////////////////////////////////////////////////////////
+void SpatialHash::DestroyProxy(int id)
+{
+    Unlink(id);
+    proxies[id].entity  = 0;
+    proxies[id].next    = freeList;
+    freeList            = id;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ClearProxies
+////////////////////////////////////////////////////////////////////////////////
+void SpatialHash::ClearProxies()
+{
+    proxies.clear();
+    oversized.clear();
+    std::fill(buckets.begin(), buckets.end(), -1);
+    freeList    = -1;
+    count       = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Query
+////////////////////////////////////////////////////////////////////////////////
+void SpatialHash::Query(const AABB& box, std::vector<Entity2D*>& result) const
+{
+    VisitBox(box, [&](Entity2D* e)
+    {
+        if(EntityBounds(e).Overlaps(box))
+            result.push_back(e);
+    });
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// CollectPairs
+////////////////////////////////////////////////////////////////////////////////
+void SpatialHash::CollectPairs(std::vector<BroadphasePair>& pairs) const
+{
+    VisitProxyPairs([&](int i, int j) { ReportPair(pairs, i, j); });
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SetCellSize
+////////////////////////////////////////////////////////////////////////////////
+void SpatialHash::SetCellSize(float size)
+{
+    assert(size > 0.0f);
+
+    cellSize    = size;
+    invCellSize = 1.0f / size;
+
+    // Placement of everything changes
+    Rehash((int)buckets.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Link a proxy based on the current entity position
+////////////////////////////////////////////////////////////////////////////////
+void SpatialHash::Link(int id)
+{
+    Proxy& p    = proxies[id];
+    float r     = p.entity->BoundingRadius();
+
+    if(IsOversized(r))
+    {
+        p.oversized = (int)oversized.size();
+        p.bucket    = -1;
+        p.prev      = -1;
+        p.next      = -1;
+        oversized.push_back(id);
+        return;
+    }
+
+    Vector2 pos = p.entity->Position();
+    p.oversized = -1;
+    p.cellX     = Cell(pos.x);
+    p.cellY     = Cell(pos.y);
+    p.bucket    = Hash(p.cellX, p.cellY);
+
+    // Push at the head of the chain
+    p.prev = -1;
+    p.next = buckets[p.bucket];
+    if(p.next != -1)
+        proxies[p.next].prev = id;
+    buckets[p.bucket] = id;
+
+    count++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Unlink a proxy
+////////////////////////////////////////////////////////////////////////////////
+void SpatialHash::Unlink(int id)
+{
+    Proxy& p = proxies[id];
+
+    if(p.oversized != -1)
+    {
+        // Swap remove from the oversized tier
+        int last = oversized.back();
+        oversized[p.oversized] = last;
+        proxies[last].oversized = p.oversized;
+        oversized.pop_back();
+        p.oversized = -1;
+        return;
+    }
+
+    if(p.prev != -1)
+        proxies[p.prev].next = p.next;
+    else
+        buckets[p.bucket] = p.next;
+    //
+    if(p.next != -1)
+        proxies[p.next].prev = p.prev;
+
+    count--;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Move a proxy only if needed
+////////////////////////////////////////////////////////////////////////////////
+void SpatialHash::MoveProxy(int id)
+{
+    Proxy& p    = proxies[id];
+    p.bounds    = EntityBounds(p.entity);
+    bool big    = IsOversized(p.entity->BoundingRadius());
+
+    // Big ones don't care about cells
+    if(big && p.oversized != -1)
+        return;
+
+    if(!big && p.oversized == -1)
+    {
+        Vector2 pos = p.entity->Position();
+        if(Cell(pos.x) == p.cellX && Cell(pos.y) == p.cellY)
+            return;
+    }
+
+    Unlink(id);
+    Link(id);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Use twice the average diameter, so that most entities fit in a cell
+// while cells stay small enough to prune well
+////////////////////////////////////////////////////////////////////////////////
+void SpatialHash::PickCellSize(const std::vector<Entity2D*>& entities)
+{
+    float total = 0.0f;
+    int n = 0;
+    for(Entity2D* e : entities)
+    {
+        float r = e->BoundingRadius();
+        if(r <= 0)
+            continue;
+        total += r;
+        n++;
+    }
+
+    if(n > 0)
+        SetCellSize(4.0f * total / n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Rehash all entities in a new bucket array
+////////////////////////////////////////////////////////////////////////////////
+void SpatialHash::Rehash(int bucketCount)
+{
+    buckets.assign(bucketCount, -1);
+    oversized.clear();
+    count = 0;
+
+    for(int i = 0; i < (int)proxies.size(); i++)
+        if(proxies[i].entity)
+            Link(i);
+}
+
+
+#ifdef DEBUG
+////////////////////////////////////////////////////////////////////////////////
+// DebugRender
+////////////////////////////////////////////////////////////////////////////////
+void SpatialHash::DebugRender()
+{
+    for(auto& p : proxies)
+    {
+        if(!p.entity)
+            continue;
+
+        if(p.oversized != -1)
+        {
+            gDebugDraw2D.AddCircle(p.entity->Position(),
+                                   p.entity->BoundingRadius(),
+                                   Color::Grey);
+            continue;
+        }
+
+        Vector2 min(p.cellX * cellSize, p.cellY * cellSize);
+        Vector2 max = min + Vector2(cellSize, cellSize);
+        gDebugDraw2D.AddRectangle(min, max, Color::Grey);
+        gDebugDraw2D.AddLine(p.entity->Position(), (min + max) * 0.5f, Color::Grey);
+    }
+}
+#endif
+
+// end
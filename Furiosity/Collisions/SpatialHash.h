@@ -0,0 +1,309 @@
+////////////////////////////////////////////////////////////////////////////////
+//  SpatialHash.h
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <list>
+
+// Local
+#include "Broadphase.h"
+
+namespace Furiosity
+{
+    ////////////////////////////////////////////////////////////////////////////////
+    // Spatial Hash
+    // A persistent uniform grid for the 2D broadphase. The cells are not stored
+    // explicitly but hashed into a fixed number of buckets, so the world can be
+    // of any size. Entities are kept between frames and only relinked when they
+    // change cells. Entities that do not fit in a cell are kept in a separate
+    // oversized tier, so one big body does not blow up the cell size.
+    ////////////////////////////////////////////////////////////////////////////////
+    class SpatialHash : public Broadphase
+    {
+    protected:
+        /// A single entry in the hash
+        struct Proxy
+        {
+            /// The owner of this proxy, null if the proxy is free
+            Entity2D*   entity;
+
+            /// Cell coordinates
+            int         cellX;
+            int         cellY;
+
+            /// Bucket this proxy is linked in
+            int         bucket;
+
+            /// Links in the bucket chain, the free list reuses next
+            int         prev;
+            int         next;
+
+            /// Position in the oversized tier or -1 if this is a regular proxy
+            int         oversized;
+
+            /// Bounds of the entity as of the last update
+            AABB        bounds;
+        };
+
+        /// All proxies, indices in here are stable for the life of an entity
+        std::vector<Proxy>                  proxies;
+
+        /// Head of the free proxy list
+        int                                 freeList;
+
+        /// Heads of the bucket chains, size is always a power of two
+        std::vector<int>                    buckets;
+
+        /// Proxies that are too big for the grid
+        std::vector<int>                    oversized;
+
+        /// Size of a single cell. Zero means it gets picked on the first update.
+        float                               cellSize;
+
+        /// Cached inverse of the above
+        float                               invCellSize;
+
+        /// Number of live proxies in the grid (not counting oversized ones)
+        int                                 count;
+
+    public:
+        /// Creates a new hash. Cell size can be left zero, in which case it will
+        /// be picked from the entities the first time the hash is updated.
+        SpatialHash(float cellSize = 0.0f, int bucketCount = 1024);
+
+        /// Sets a new cell size and rehashes all the entities
+        void SetCellSize(float size);
+
+        /// Gets the size of the cells
+        float CellSize() const { return cellSize; }
+
+        /// Number of entities in the oversized tier
+        int OversizedCount() const { return (int)oversized.size(); }
+
+        /// Calls visitor(Entity2D*) for each entity that could touch this one,
+        /// including the entity itself if it's in the hash. No memory is allocated.
+        template<class Visitor>
+        void VisitNeighbours(const Entity2D& entity, const Visitor& visitor) const;
+
+        /// Calls visitor(Entity2D*) for each entity that could overlap the box.
+        /// No memory is allocated.
+        template<class Visitor>
+        void VisitBox(const AABB& box, const Visitor& visitor) const;
+
+        /// Calls visitor(Entity2D*, Entity2D*) once for each pair of entities
+        /// with overlapping bounds. No memory is allocated.
+        template<class Visitor>
+        void VisitPairs(const Visitor& visitor) const;
+
+        /// Broadphase override
+        virtual void CollectPairs(std::vector<BroadphasePair>& pairs) const;
+
+        /// Broadphase override
+        virtual void Query(const AABB& box, std::vector<Entity2D*>& result) const;
+
+#ifdef DEBUG
+        virtual void DebugRender();
+#endif
+
+    protected:
+        /// Picks a cell size if there is none yet
+        virtual bool BeginUpdate(const std::vector<Entity2D*>& entities);
+
+        /// Keeps the chains short
+        virtual void EndUpdate();
+
+        /// Links a new proxy
+        virtual int  CreateProxy(Entity2D* entity);
+
+        /// Relinks a proxy only if it changed cells
+        virtual void MoveProxy(int id);
+
+        /// Unlinks the proxy and puts it on the free list
+        virtual void DestroyProxy(int id);
+
+        /// Drops everything
+        virtual void ClearProxies();
+
+        /// Hashes a cell to a bucket index
+        int Hash(int x, int y) const
+        {
+            return (int)(((uint)x * 73856093u) ^ ((uint)y * 19349663u)) & ((int)buckets.size() - 1);
+        }
+
+        /// Cell coordinate of a position along one axis
+        int Cell(float v) const { return (int)floorf(v * invCellSize); }
+
+        /// Checks if an entity is too big for the grid
+        bool IsOversized(float radius) const { return radius * 2.0f > cellSize; }
+
+        /// Links a proxy in the grid or the oversized tier
+        void Link(int id);
+
+        /// Unlinks a proxy from wherever it is
+        void Unlink(int id);
+
+        /// Picks a cell size based on the entities
+        void PickCellSize(const std::vector<Entity2D*>& entities);
+
+        /// Grows the bucket array when the load gets too high
+        void Rehash(int bucketCount);
+
+        /// Visit all the proxies in a single cell
+        template<class Visitor>
+        void VisitCell(int x, int y, const Visitor& visitor) const;
+
+        /// Checks if the bounds of two proxies overlap
+        bool Overlap(int i, int j) const
+        {
+            return proxies[i].bounds.Overlaps(proxies[j].bounds);
+        }
+
+        /// Calls visitor(int, int) once for each pair of proxies with
+        /// overlapping bounds
+        template<class Visitor>
+        void VisitProxyPairs(const Visitor& visitor) const;
+    };
+
+
+    ////////////////////////////////////////////////////////////////////////////////
+    //
+    //                            - Implemetation -
+    //
+    ////////////////////////////////////////////////////////////////////////////////
+
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Visit a single cell, filtering out other cells hashed in the same bucket
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class Visitor>
+    void SpatialHash::VisitCell(int x, int y, const Visitor& visitor) const
+    {
+        for(int i = buckets[Hash(x, y)]; i != -1; i = proxies[i].next)
+        {
+            const Proxy& p = proxies[i];
+            if(p.cellX == x && p.cellY == y)
+                visitor(i);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // VisitNeighbours
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class Visitor>
+    void SpatialHash::VisitNeighbours(const Entity2D& entity, const Visitor& visitor) const
+    {
+        VisitBox(EntityBounds(&entity), visitor);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // VisitBox
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class Visitor>
+    void SpatialHash::VisitBox(const AABB& box, const Visitor& visitor) const
+    {
+        if(cellSize <= 0.0f)
+            return;
+
+        // Cover all the cells that a regular proxy touching the box can be in
+        float r     = cellSize * 0.5f;
+        int xfrom   = Cell(box.Min.x - r);
+        int xto     = Cell(box.Max.x + r);
+        int yfrom   = Cell(box.Min.y - r);
+        int yto     = Cell(box.Max.y + r);
+
+        auto report = [&](int i) { visitor(proxies[i].entity); };
+
+        // Linear scan is cheaper than a huge number of cells
+        if(float(xto - xfrom + 1) * float(yto - yfrom + 1) > count)
+        {
+            for(int i = 0; i < (int)proxies.size(); i++)
+                if(proxies[i].entity && proxies[i].oversized == -1)
+                    report(i);
+        }
+        else
+        {
+            for(int x = xfrom; x <= xto; x++)
+                for(int y = yfrom; y <= yto; y++)
+                    VisitCell(x, y, report);
+        }
+
+        // Big ones are always neighbours
+        for(int i : oversized)
+            report(i);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // VisitPairs
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class Visitor>
+    void SpatialHash::VisitPairs(const Visitor& visitor) const
+    {
+        VisitProxyPairs([&](int i, int j) { visitor(proxies[i].entity, proxies[j].entity); });
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // VisitProxyPairs
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class Visitor>
+    void SpatialHash::VisitProxyPairs(const Visitor& visitor) const
+    {
+        // Regular proxies only need to look at half of the neighbourhood, so
+        // that each pair is reported exactly once
+        for(int i = 0; i < (int)proxies.size(); i++)
+        {
+            const Proxy& p = proxies[i];
+            if(!p.entity || p.oversized != -1)
+                continue;
+
+            // Neighbouring cells don't mean the bounds overlap
+            auto report = [&](int j) { if(Overlap(i, j)) visitor(i, j); };
+
+            // Same cell, but only further down the chain
+            for(int j = p.next; j != -1; j = proxies[j].next)
+                if(proxies[j].cellX == p.cellX && proxies[j].cellY == p.cellY)
+                    report(j);
+            //
+            VisitCell(p.cellX + 1, p.cellY,     report);
+            VisitCell(p.cellX - 1, p.cellY + 1, report);
+            VisitCell(p.cellX,     p.cellY + 1, report);
+            VisitCell(p.cellX + 1, p.cellY + 1, report);
+        }
+
+        // Oversized against everything
+        for(size_t k = 0; k < oversized.size(); k++)
+        {
+            const Proxy& p = proxies[oversized[k]];
+
+            // Other big ones
+            for(size_t l = k + 1; l < oversized.size(); l++)
+                if(Overlap(oversized[k], oversized[l]))
+                    visitor(oversized[k], oversized[l]);
+
+            // Regular ones that can be reached
+            Vector2 pos = p.entity->Position();
+            float r     = p.entity->BoundingRadius() + cellSize * 0.5f;
+            int xfrom   = Cell(pos.x - r);
+            int xto     = Cell(pos.x + r);
+            int yfrom   = Cell(pos.y - r);
+            int yto     = Cell(pos.y + r);
+
+            auto report = [&](int j) { if(Overlap(oversized[k], j)) visitor(oversized[k], j); };
+
+            if(float(xto - xfrom + 1) * float(yto - yfrom + 1) > count)
+            {
+                for(int j = 0; j < (int)proxies.size(); j++)
+                    if(proxies[j].entity && proxies[j].oversized == -1)
+                        report(j);
+            }
+            else
+            {
+                for(int x = xfrom; x <= xto; x++)
+                    for(int y = yfrom; y <= yto; y++)
+                        VisitCell(x, y, report);
+            }
+        }
+    }
+}
@@ -0,0 +1,265 @@
+////////////////////////////////////////////////////////////////////////////////
+//  SpatialHash3D.cpp
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#include "SpatialHash3D.h"
+
+using namespace Furiosity;
+
+////////////////////////////////////////////////////////////////////////////////
+// Ctor
+////////////////////////////////////////////////////////////////////////////////
+SpatialHash3D::SpatialHash3D(float cellSize, int bucketCount) :
+    freeList(-1),
+    cellSize(0.0f),
+    invCellSize(0.0f),
+    count(0),
+    stamp(0)
+{
+    // Round up to a power of two so hashing can use a mask
+    int size = 1;
+    while(size < bucketCount)
+        size <<= 1;
+    buckets.resize(size, -1);
+
+    if(cellSize > 0.0f)
+        SetCellSize(cellSize);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Update
+////////////////////////////////////////////////////////////////////////////////
+void SpatialHash3D::Update(const std::vector<Entity3D*>& entities)
+{
+    if(cellSize <= 0.0f)
+        PickCellSize(entities);
+
+    // Nothing to put in the hash yet
+    if(cellSize <= 0.0f)
+        return;
+
+    stamp++;
+
+    for(Entity3D* e : entities)
+    {
+        // If no collision, then skip this entitiy
+        if(e->BoundingRadius() <= 0)
+            continue;
+
+        int id;
+        auto itr = lookup.find(e);
+        if(itr == lookup.end())
+        {
+            id = CreateProxy(e);
+            lookup[e] = id;
+        }
+        else
+        {
+            id = itr->second;
+            MoveProxy(id);
+        }
+        proxies[id].stamp = stamp;
+    }
+
+    // Drop entities that were not in the list
+    for(int i = 0; i < (int)proxies.size(); i++)
+    {
+        if(proxies[i].entity && proxies[i].stamp != stamp)
+        {
+            lookup.erase(proxies[i].entity);
+            DestroyProxy(i);
+        }
+    }
+
+    // Keep the chains short
+    if(count > 2 * (int)buckets.size())
+        Rehash((int)buckets.size() * 4);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Clear
+////////////////////////////////////////////////////////////////////////////////
+void SpatialHash3D::Clear()
+{
+    lookup.clear();
+    proxies.clear();
+    oversized.clear();
+    std::fill(buckets.begin(), buckets.end(), -1);
+    freeList    = -1;
+    count       = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SetCellSize
+////////////////////////////////////////////////////////////////////////////////
+void SpatialHash3D::SetCellSize(float size)
+{
+    assert(size > 0.0f);
+
+    cellSize    = size;
+    invCellSize = 1.0f / size;
+
+    // Placement of everything changes
+    Rehash((int)buckets.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// CreateProxy
+////////////////////////////////////////////////////////////////////////////////
+int SpatialHash3D::CreateProxy(Entity3D* entity)
+{
+    // Grab a proxy, recycle if possible
+    int id;
+    if(freeList != -1)
+    {
+        id = freeList;
+        freeList = proxies[id].next;
+    }
+    else
+    {
+        id = (int)proxies.size();
+        proxies.push_back(Proxy());
+    }
+
+    proxies[id].entity      = entity;
+    proxies[id].position    = entity->Position();
+    proxies[id].radius      = entity->BoundingRadius();
+    Link(id);
+    return id;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// DestroyProxy
+////////////////////////////////////////////////////////////////////////////////
+void SpatialHash3D::DestroyProxy(int id)
+{
+    Unlink(id);
+    proxies[id].entity  = 0;
+    proxies[id].next    = freeList;
+    freeList            = id;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Link a proxy based on the bounds it keeps
+////////////////////////////////////////////////////////////////////////////////
+void SpatialHash3D::Link(int id)
+{
+    Proxy& p = proxies[id];
+
+    if(IsOversized(p.radius))
+    {
+        p.oversized = (int)oversized.size();
+        p.bucket    = -1;
+        p.prev      = -1;
+        p.next      = -1;
+        oversized.push_back(id);
+        return;
+    }
+
+    p.oversized = -1;
+    p.cellX     = Cell(p.position.x);
+    p.cellY     = Cell(p.position.y);
+    p.cellZ     = Cell(p.position.z);
+    p.bucket    = Hash(p.cellX, p.cellY, p.cellZ);
+
+    // Push at the head of the chain
+    p.prev = -1;
+    p.next = buckets[p.bucket];
+    if(p.next != -1)
+        proxies[p.next].prev = id;
+    buckets[p.bucket] = id;
+
+    count++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Unlink a proxy
+////////////////////////////////////////////////////////////////////////////////
+void SpatialHash3D::Unlink(int id)
+{
+    Proxy& p = proxies[id];
+
+    if(p.oversized != -1)
+    {
+        // Swap remove from the oversized tier
+        int last = oversized.back();
+        oversized[p.oversized] = last;
+        proxies[last].oversized = p.oversized;
+        oversized.pop_back();
+        p.oversized = -1;
+        return;
+    }
+
+    if(p.prev != -1)
+        proxies[p.prev].next = p.next;
+    else
+        buckets[p.bucket] = p.next;
+    //
+    if(p.next != -1)
+        proxies[p.next].prev = p.prev;
+
+    count--;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Move a proxy only if needed
+////////////////////////////////////////////////////////////////////////////////
+void SpatialHash3D::MoveProxy(int id)
+{
+    Proxy& p    = proxies[id];
+    p.position  = p.entity->Position();
+    p.radius    = p.entity->BoundingRadius();
+    bool big    = IsOversized(p.radius);
+
+    // Big ones don't care about cells
+    if(big && p.oversized != -1)
+        return;
+
+    if(!big && p.oversized == -1)
+    {
+        const Vector3& pos = p.position;
+        if(Cell(pos.x) == p.cellX && Cell(pos.y) == p.cellY && Cell(pos.z) == p.cellZ)
+            return;
+    }
+
+    Unlink(id);
+    Link(id);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Same as in 2D, four times the average radius
+////////////////////////////////////////////////////////////////////////////////
+void SpatialHash3D::PickCellSize(const std::vector<Entity3D*>& entities)
+{
+    float total = 0.0f;
+    int n = 0;
+    for(Entity3D* e : entities)
+    {
+        float r = e->BoundingRadius();
+        if(r <= 0)
+            continue;
+        total += r;
+        n++;
+    }
+
+    if(n > 0)
+        SetCellSize(4.0f * total / n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Rehash all entities in a new bucket array. Removed entities can still have
+// a proxy until the next update, so only the kept bounds are used.
+////////////////////////////////////////////////////////////////////////////////
+void SpatialHash3D::Rehash(int bucketCount)
+{
+    buckets.assign(bucketCount, -1);
+    oversized.clear();
+    count = 0;
+
+    for(int i = 0; i < (int)proxies.size(); i++)
+        if(proxies[i].entity)
+            Link(i);
+}
+
+// end
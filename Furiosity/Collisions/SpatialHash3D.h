@@ -0,0 +1,256 @@
+////////////////////////////////////////////////////////////////////////////////
+//  SpatialHash3D.h
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cassert>
+
+// Local
+#include "Entity3D.h"
+
+namespace Furiosity
+{
+    ////////////////////////////////////////////////////////////////////////////////
+    // Spatial Hash 3D
+    // The 3D take on the spatial hash, a persistent uniform grid for the bounding
+    // spheres of 3D entities. Cells are hashed into a fixed number of buckets, so
+    // the world can be of any size. Entities are kept between frames and only
+    // relinked when they change cells, and entities that don't fit in a cell go
+    // to an oversized tier.
+    ////////////////////////////////////////////////////////////////////////////////
+    class SpatialHash3D
+    {
+    protected:
+        /// A single entry in the hash
+        struct Proxy
+        {
+            /// The owner of this proxy, null if the proxy is free
+            Entity3D*   entity;
+
+            /// Bounds as of the last update, so the hash can be rebuilt
+            /// without touching an entity that might be gone
+            Vector3     position;
+            float       radius;
+
+            /// Cell coordinates
+            int         cellX;
+            int         cellY;
+            int         cellZ;
+
+            /// Bucket this proxy is linked in
+            int         bucket;
+
+            /// Links in the bucket chain, the free list reuses next
+            int         prev;
+            int         next;
+
+            /// Position in the oversized tier or -1 if this is a regular proxy
+            int         oversized;
+
+            /// Stamp of the last update that saw the entity
+            uint        stamp;
+        };
+
+        /// Maps entities to proxies
+        std::unordered_map<Entity3D*, int>  lookup;
+
+        /// All proxies, indices in here are stable for the life of an entity
+        std::vector<Proxy>                  proxies;
+
+        /// Head of the free proxy list
+        int                                 freeList;
+
+        /// Heads of the bucket chains, size is always a power of two
+        std::vector<int>                    buckets;
+
+        /// Proxies that are too big for the grid
+        std::vector<int>                    oversized;
+
+        /// Size of a single cell. Zero means it gets picked on the first update.
+        float                               cellSize;
+
+        /// Cached inverse of the above
+        float                               invCellSize;
+
+        /// Number of live proxies in the grid (not counting oversized ones)
+        int                                 count;
+
+        /// Current update stamp
+        uint                                stamp;
+
+    public:
+        /// Creates a new hash. Cell size can be left zero, in which case it will
+        /// be picked from the entities the first time the hash is updated.
+        SpatialHash3D(float cellSize = 0.0f, int bucketCount = 1024);
+
+        /// Brings the hash up to date with the entities. New entities are
+        /// inserted, existing ones are moved and entities that are not in the
+        /// list anymore are dropped. Entities without a bounding radius are
+        /// left out.
+        void Update(const std::vector<Entity3D*>& entities);
+
+        /// Removes all entities
+        void Clear();
+
+        /// Sets a new cell size and rehashes all the entities
+        void SetCellSize(float size);
+
+        /// Gets the size of the cells
+        float CellSize() const { return cellSize; }
+
+        /// Number of entities in the hash
+        int Size() const { return (int)lookup.size(); }
+
+        /// Number of entities in the oversized tier
+        int OversizedCount() const { return (int)oversized.size(); }
+
+        /// Calls visitor(Entity3D*, Entity3D*) once for each pair of entities
+        /// that could be touching. No memory is allocated.
+        template<class Visitor>
+        void VisitPairs(const Visitor& visitor) const;
+
+    protected:
+        /// Grabs a proxy and links it
+        int  CreateProxy(Entity3D* entity);
+
+        /// Relinks a proxy only if it changed cells
+        void MoveProxy(int id);
+
+        /// Unlinks the proxy and puts it on the free list. Doesn't touch the
+        /// entity, as it might have been deleted already.
+        void DestroyProxy(int id);
+
+        /// Hashes a cell to a bucket index
+        int Hash(int x, int y, int z) const
+        {
+            return (int)(((uint)x * 73856093u) ^
+                         ((uint)y * 19349663u) ^
+                         ((uint)z * 83492791u)) & ((int)buckets.size() - 1);
+        }
+
+        /// Cell coordinate of a position along one axis
+        int Cell(float v) const { return (int)floorf(v * invCellSize); }
+
+        /// Checks if an entity is too big for the grid
+        bool IsOversized(float radius) const { return radius * 2.0f > cellSize; }
+
+        /// Links a proxy in the grid or the oversized tier, by its bounds
+        void Link(int id);
+
+        /// Unlinks a proxy from wherever it is
+        void Unlink(int id);
+
+        /// Picks a cell size based on the entities
+        void PickCellSize(const std::vector<Entity3D*>& entities);
+
+        /// Grows the bucket array when the load gets too high
+        void Rehash(int bucketCount);
+
+        /// Visit all the proxies in a single cell
+        template<class Visitor>
+        void VisitCell(int x, int y, int z, const Visitor& visitor) const;
+    };
+
+
+    ////////////////////////////////////////////////////////////////////////////////
+    //
+    //                            - Implemetation -
+    //
+    ////////////////////////////////////////////////////////////////////////////////
+
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Visit a single cell, filtering out other cells hashed in the same bucket
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class Visitor>
+    void SpatialHash3D::VisitCell(int x, int y, int z, const Visitor& visitor) const
+    {
+        for(int i = buckets[Hash(x, y, z)]; i != -1; i = proxies[i].next)
+        {
+            const Proxy& p = proxies[i];
+            if(p.cellX == x && p.cellY == y && p.cellZ == z)
+                visitor(i);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // VisitPairs
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class Visitor>
+    void SpatialHash3D::VisitPairs(const Visitor& visitor) const
+    {
+        // Half of the 26 neighbours, so that each pair is reported exactly once
+        static const int Forward[13][3] =
+        {
+            { 1, 0, 0 },
+            {-1, 1, 0 }, { 0, 1, 0 }, { 1, 1, 0 },
+            {-1,-1, 1 }, { 0,-1, 1 }, { 1,-1, 1 },
+            {-1, 0, 1 }, { 0, 0, 1 }, { 1, 0, 1 },
+            {-1, 1, 1 }, { 0, 1, 1 }, { 1, 1, 1 }
+        };
+
+        for(int i = 0; i < (int)proxies.size(); i++)
+        {
+            const Proxy& p = proxies[i];
+            if(!p.entity || p.oversized != -1)
+                continue;
+
+            auto report = [&](int j) { visitor(p.entity, proxies[j].entity); };
+
+            // Same cell, but only further down the chain
+            for(int j = p.next; j != -1; j = proxies[j].next)
+            {
+                const Proxy& q = proxies[j];
+                if(q.cellX == p.cellX && q.cellY == p.cellY && q.cellZ == p.cellZ)
+                    report(j);
+            }
+            //
+            for(int k = 0; k < 13; k++)
+                VisitCell(p.cellX + Forward[k][0],
+                          p.cellY + Forward[k][1],
+                          p.cellZ + Forward[k][2],
+                          report);
+        }
+
+        // Oversized against everything
+        for(size_t k = 0; k < oversized.size(); k++)
+        {
+            const Proxy& p = proxies[oversized[k]];
+
+            // Other big ones
+            for(size_t l = k + 1; l < oversized.size(); l++)
+                visitor(p.entity, proxies[oversized[l]].entity);
+
+            // Regular ones that can be reached
+            Vector3 pos = p.position;
+            float r     = p.radius + cellSize * 0.5f;
+            int xfrom   = Cell(pos.x - r);
+            int xto     = Cell(pos.x + r);
+            int yfrom   = Cell(pos.y - r);
+            int yto     = Cell(pos.y + r);
+            int zfrom   = Cell(pos.z - r);
+            int zto     = Cell(pos.z + r);
+
+            auto report = [&](int j) { visitor(p.entity, proxies[j].entity); };
+
+            // Linear scan is cheaper than a huge number of cells
+            if(float(xto - xfrom + 1) * float(yto - yfrom + 1) * float(zto - zfrom + 1) > count)
+            {
+                for(int j = 0; j < (int)proxies.size(); j++)
+                    if(proxies[j].entity && proxies[j].oversized == -1)
+                        report(j);
+            }
+            else
+            {
+                for(int x = xfrom; x <= xto; x++)
+                    for(int y = yfrom; y <= yto; y++)
+                        for(int z = zfrom; z <= zto; z++)
+                            VisitCell(x, y, z, report);
+            }
+        }
+    }
+}
@@ -0,0 +1,334 @@
+////////////////////////////////////////////////////////////////////////////////
+//  SweepAndPrune.cpp
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#include "SweepAndPrune.h"
+
+#include <algorithm>
+
+#include "DebugDraw2D.h"
+
+using namespace Furiosity;
+
+////////////////////////////////////////////////////////////////////////////////
+// CreateProxy
+////////////////////////////////////////////////////////////////////////////////
+int SweepAndPrune::CreateProxy(Entity2D* entity)
+{
+    int id;
+    if(!freeProxies.empty())
+    {
+        id = freeProxies.back();
+        freeProxies.pop_back();
+    }
+    else
+    {
+        id = (int)proxies.size();
+        proxies.push_back(Proxy());
+    }
+
+    Proxy& p = proxies[id];
+    p.entity = entity;
+    UpdateBounds(p);
+
+    // Endpoints go at the end and get sorted in place
+    for(int axis = 0; axis < 2; axis++)
+    {
+        Endpoint min = { p.min[axis], id << 1 };
+        Endpoint max = { p.max[axis], (id << 1) | 1 };
+        axes[axis].push_back(min);
+        axes[axis].push_back(max);
+    }
+
+    created++;
+    return id;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// MoveProxy
+////////////////////////////////////////////////////////////////////////////////
+void SweepAndPrune::MoveProxy(int id)
+{
+    UpdateBounds(proxies[id]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// DestroyProxy
+////////////////////////////////////////////////////////////////////////////////
+void SweepAndPrune::DestroyProxy(int id)
+{
+    proxies[id].entity = 0;
+    deadProxies.push_back(id);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ClearProxies
+////////////////////////////////////////////////////////////////////////////////
+void SweepAndPrune::ClearProxies()
+{
+    proxies.clear();
+    freeProxies.clear();
+    deadProxies.clear();
+    axes[0].clear();
+    axes[1].clear();
+    pairs.clear();
+    pairLookup.clear();
+    created = 0;
+    maxWidth = 0.0f;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// UpdateBounds
+////////////////////////////////////////////////////////////////////////////////
+void SweepAndPrune::UpdateBounds(Proxy& proxy)
+{
+    Vector2 pos = proxy.entity->Position();
+    float r     = proxy.entity->BoundingRadius();
+    //
+    proxy.min[0] = pos.x - r;
+    proxy.max[0] = pos.x + r;
+    proxy.min[1] = pos.y - r;
+    proxy.max[1] = pos.y + r;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EndUpdate
+////////////////////////////////////////////////////////////////////////////////
+void SweepAndPrune::EndUpdate()
+{
+    if(!deadProxies.empty())
+        RemoveDead();
+
+    // Many new proxies would make the insertion sort quadratic
+    if(created > 16 && created * 4 > (int)axes[0].size() / 2)
+    {
+        Rebuild();
+    }
+    else
+    {
+        // Refresh endpoint values from the bounds
+        for(int axis = 0; axis < 2; axis++)
+        {
+            for(Endpoint& e : axes[axis])
+            {
+                const Proxy& p = proxies[e.Proxy()];
+                e.value = e.IsMax() ? p.max[axis] : p.min[axis];
+            }
+            SortAxis(axis);
+        }
+    }
+
+    created = 0;
+
+    maxWidth = 0.0f;
+    for(const Proxy& p : proxies)
+        if(p.entity)
+            maxWidth = std::max(maxWidth, p.max[0] - p.min[0]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SortAxis
+// Insertion sort, only endpoints moving to the left need to be handled as
+// any move to the right is the same as the other endpoint moving left.
+////////////////////////////////////////////////////////////////////////////////
+void SweepAndPrune::SortAxis(int axis)
+{
+    std::vector<Endpoint>& endpoints = axes[axis];
+    //
+    for(int i = 1; i < (int)endpoints.size(); i++)
+    {
+        Endpoint key = endpoints[i];
+        int j = i - 1;
+
+        while(j >= 0 && endpoints[j].value > key.value)
+        {
+            const Endpoint& other = endpoints[j];
+
+            if(!key.IsMax() && other.IsMax())
+            {
+                // A min passing a max, the intervals start to overlap
+                if(Overlap(key.Proxy(), other.Proxy()))
+                    AddPair(key.Proxy(), other.Proxy());
+            }
+            else if(key.IsMax() && !other.IsMax())
+            {
+                // A max passing a min, the intervals stop overlapping
+                RemovePair(key.Proxy(), other.Proxy());
+            }
+
+            endpoints[j + 1] = other;
+            j--;
+        }
+
+        endpoints[j + 1] = key;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Rebuild
+////////////////////////////////////////////////////////////////////////////////
+void SweepAndPrune::Rebuild()
+{
+    for(int axis = 0; axis < 2; axis++)
+    {
+        for(Endpoint& e : axes[axis])
+        {
+            const Proxy& p = proxies[e.Proxy()];
+            e.value = e.IsMax() ? p.max[axis] : p.min[axis];
+        }
+
+        std::sort(axes[axis].begin(), axes[axis].end(),
+                  [](const Endpoint& a, const Endpoint& b)
+                  { return a.value < b.value; });
+    }
+
+    pairs.clear();
+    pairLookup.clear();
+
+    // Sweep along x, keeping a list of open intervals
+    std::vector<int>& open = deadProxies;   // Empty at this point, reuse it
+    for(const Endpoint& e : axes[0])
+    {
+        int id = e.Proxy();
+        if(e.IsMax())
+        {
+            auto itr = std::find(open.begin(), open.end(), id);
+            *itr = open.back();
+            open.pop_back();
+        }
+        else
+        {
+            for(int other : open)
+                if(Overlap(id, other))
+                    AddPair(id, other);
+            open.push_back(id);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// RemoveDead
+////////////////////////////////////////////////////////////////////////////////
+void SweepAndPrune::RemoveDead()
+{
+    // Compact the endpoints
+    for(int axis = 0; axis < 2; axis++)
+    {
+        std::vector<Endpoint>& endpoints = axes[axis];
+        endpoints.erase(std::remove_if(endpoints.begin(), endpoints.end(),
+                                       [this](const Endpoint& e)
+                                       { return proxies[e.Proxy()].entity == 0; }),
+                        endpoints.end());
+    }
+
+    // Drop their pairs
+    for(size_t i = 0; i < pairs.size();)
+    {
+        const Pair& p = pairs[i];
+        if(proxies[p.first].entity == 0 || proxies[p.second].entity == 0)
+            RemovePair(p.first, p.second);   // Swaps the last one in here
+        else
+            i++;
+    }
+
+    // Now they can be reused
+    freeProxies.insert(freeProxies.end(), deadProxies.begin(), deadProxies.end());
+    deadProxies.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// AddPair
+////////////////////////////////////////////////////////////////////////////////
+void SweepAndPrune::AddPair(int a, int b)
+{
+    uint64 id = PairID(a, b);
+    if(pairLookup.find(id) != pairLookup.end())
+        return;
+
+    Pair pair = { a, b };
+    pairLookup[id] = (int)pairs.size();
+    pairs.push_back(pair);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// RemovePair
+////////////////////////////////////////////////////////////////////////////////
+void SweepAndPrune::RemovePair(int a, int b)
+{
+    auto itr = pairLookup.find(PairID(a, b));
+    if(itr == pairLookup.end())
+        return;
+
+    // Swap remove
+    int idx = itr->second;
+    pairLookup.erase(itr);
+    //
+    if(idx != (int)pairs.size() - 1)
+    {
+        pairs[idx] = pairs.back();
+        pairLookup[PairID(pairs[idx].first, pairs[idx].second)] = idx;
+    }
+    pairs.pop_back();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// CollectPairs
+////////////////////////////////////////////////////////////////////////////////
+void SweepAndPrune::CollectPairs(std::vector<BroadphasePair>& result) const
+{
+    for(const Pair& p : pairs)
+        ReportPair(result, p.first, p.second);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Query
+////////////////////////////////////////////////////////////////////////////////
+void SweepAndPrune::Query(const AABB& box, std::vector<Entity2D*>& result) const
+{
+    // A proxy that overlaps the box starts at most maxWidth before it
+    const std::vector<Endpoint>& endpoints = axes[0];
+    float from = box.Min.x - maxWidth;
+    auto itr = std::lower_bound(endpoints.begin(), endpoints.end(), from,
+                                [](const Endpoint& e, float value)
+                                {
+                                    return e.value < value;
+                                });
+
+    // Each proxy has one min endpoint, so nothing is reported twice
+    for(; itr != endpoints.end() && itr->value <= box.Max.x; ++itr)
+    {
+        if(itr->IsMax())
+            continue;
+
+        const Proxy& p = proxies[itr->Proxy()];
+        if(p.max[0] >= box.Min.x &&
+           p.max[1] >= box.Min.y && p.min[1] <= box.Max.y)
+            result.push_back(p.entity);
+    }
+}
+
+
+#ifdef DEBUG
+////////////////////////////////////////////////////////////////////////////////
+// DebugRender
+////////////////////////////////////////////////////////////////////////////////
+void SweepAndPrune::DebugRender()
+{
+    for(const Proxy& p : proxies)
+    {
+        if(!p.entity)
+            continue;
+        gDebugDraw2D.AddRectangle(Vector2(p.min[0], p.min[1]),
+                                  Vector2(p.max[0], p.max[1]),
+                                  Color::Grey);
+    }
+
+    for(const Pair& p : pairs)
+        gDebugDraw2D.AddLine(proxies[p.first].entity->Position(),
+                             proxies[p.second].entity->Position(),
+                             Color::Grey);
+}
+#endif
+
+// end
@@ -0,0 +1,156 @@
+////////////////////////////////////////////////////////////////////////////////
+//  SweepAndPrune.h
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+
+// Local
+#include "Broadphase.h"
+
+namespace Furiosity
+{
+    ////////////////////////////////////////////////////////////////////////////////
+    // Sweep And Prune
+    // Keeps the bounds of all entities as sorted endpoint arrays along both
+    // axes. The arrays are kept from frame to frame and re-sorted with an
+    // insertion sort, which is close to linear as things don't move much between
+    // frames. Every swap of two endpoints tells if a pair started or stopped
+    // overlapping, so the set of overlapping pairs is maintained incrementally.
+    // Works well for long levels where a grid would be mostly empty.
+    ////////////////////////////////////////////////////////////////////////////////
+    class SweepAndPrune : public Broadphase
+    {
+    protected:
+        /// A single entity in the broadphase
+        struct Proxy
+        {
+            /// The owner of this proxy, null if the proxy is dead
+            Entity2D*   entity;
+
+            /// Bounds along each axis
+            float       min[2];
+            float       max[2];
+        };
+
+        /// An interval endpoint along an axis
+        struct Endpoint
+        {
+            /// Position on the axis
+            float       value;
+
+            /// Proxy index shifted left by one, lowest bit is set for max endpoints
+            int         data;
+
+            int         Proxy() const   { return data >> 1; }
+            bool        IsMax() const   { return (data & 1) != 0; }
+        };
+
+        /// An overlapping pair of proxies
+        struct Pair
+        {
+            int         first;
+            int         second;
+        };
+
+        /// All the proxies, indices in here are stable for the life of an entity
+        std::vector<Proxy>                  proxies;
+
+        /// Proxies free for reuse
+        std::vector<int>                    freeProxies;
+
+        /// Proxies that died in this update, they get recycled once cleaned up
+        std::vector<int>                    deadProxies;
+
+        /// Sorted endpoints along x and y
+        std::vector<Endpoint>               axes[2];
+
+        /// Currently overlapping pairs
+        std::vector<Pair>                   pairs;
+
+        /// Maps a pair id to a position in the pairs vector
+        std::unordered_map<uint64, int>     pairLookup;
+
+        /// Number of proxies created in this update
+        int                                 created;
+
+        /// Widest proxy along x, queries look this far back for proxies
+        /// that start before the box
+        float                               maxWidth;
+
+    public:
+        /// Ctor
+        SweepAndPrune() : created(0), maxWidth(0.0f) {}
+
+        /// Number of currently overlapping pairs
+        int PairCount() const { return (int)pairs.size(); }
+
+        /// Broadphase override
+        virtual void CollectPairs(std::vector<BroadphasePair>& pairs) const;
+
+        /// Broadphase override, a binary search on the x axis and a walk over
+        /// the endpoints up to the end of the box. A very wide proxy widens
+        /// the walk for all queries.
+        virtual void Query(const AABB& box, std::vector<Entity2D*>& result) const;
+
+#ifdef DEBUG
+        virtual void DebugRender();
+#endif
+
+    protected:
+        /// Refreshes the endpoints and sorts them
+        virtual void EndUpdate();
+
+        /// Adds a proxy and its endpoints at the end of the arrays
+        virtual int  CreateProxy(Entity2D* entity);
+
+        /// Refreshes the bounds of a proxy
+        virtual void MoveProxy(int id);
+
+        /// Marks a proxy as dead
+        virtual void DestroyProxy(int id);
+
+        /// Drops everything
+        virtual void ClearProxies();
+
+        /// Sets the bounds of a proxy from its entity
+        void UpdateBounds(Proxy& proxy);
+
+        /// Full bounds overlap test of two proxies
+        bool Overlap(int a, int b) const
+        {
+            const Proxy& pa = proxies[a];
+            const Proxy& pb = proxies[b];
+            return  pa.min[0] <= pb.max[0] && pb.min[0] <= pa.max[0] &&
+                    pa.min[1] <= pb.max[1] && pb.min[1] <= pa.max[1];
+        }
+
+        /// Unique id of an unordered pair of proxies
+        uint64 PairID(int a, int b) const
+        {
+            if(a > b)
+                std::swap(a, b);
+            return ((uint64)a << 32) | (uint64)b;
+        }
+
+        /// Adds a pair if not already there
+        void AddPair(int a, int b);
+
+        /// Removes a pair if it's there
+        void RemovePair(int a, int b);
+
+        /// Removes dead proxies from the endpoints and pairs
+        void RemoveDead();
+
+        /// Insertion sort an axis, reporting overlap changes along the way
+        void SortAxis(int axis);
+
+        /// Sorts everything from scratch and finds all the pairs with a single
+        /// sweep. Used when a lot of proxies are added at once.
+        void Rebuild();
+    };
+}
@@ -6,6 +6,8 @@
 
 #include "Device.h"
 
+#include <thread>
+
 using namespace Furiosity;
 using namespace std;
 
@@ -148,6 +150,12 @@ Vector2 Device::PhysicalScreenSize() const
 }
 
 
+int Device::ProcessorCount()
+{
+    // Zero when it can't be told
+    int count = (int)std::thread::hardware_concurrency();
+    return count > 0 ? count : 1;
+}
 
 
 
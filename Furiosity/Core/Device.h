@@ -148,6 +148,13 @@ public:
     /// @returns The physical screen size in centimeters
     ///
     Vector2 PhysicalScreenSize() const;
+    
+    ///
+    /// Number of threads the hardware can run at the same time, at least one.
+    ///
+    /// @returns processor (core) count
+    ///
+    static int ProcessorCount();
 };
 
 }
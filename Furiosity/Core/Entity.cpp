@@ -17,7 +17,7 @@ int Entity::nextValidID = 1;
 ////////////////////////////////////////////////////////////////////////////////
 // Ctor
 ////////////////////////////////////////////////////////////////////////////////
-Entity::Entity() :type(default_entity_type), tag(false)
+Entity::Entity() :removing(false), simulating(false), tag(false), type(default_entity_type), threadSafe(false)
 {
     SetID(nextValidID);
 }
@@ -26,8 +26,11 @@ Entity::Entity() :type(default_entity_type), tag(false)
 // Ctor
 ////////////////////////////////////////////////////////////////////////////////
 Entity::Entity(uint ID)
-:	type(default_entity_type),
-    tag(false)
+:	removing(false),
+    simulating(false),
+    tag(false),
+    type(default_entity_type),
+    threadSafe(false)
 {
     SetID(ID);
 }
@@ -39,8 +42,11 @@ Entity::Entity(uint ID)
 // streaming at the same time.
 ////////////////////////////////////////////////////////////////////////////////
 Entity::Entity(const XMLElement* settings)
-:   type(default_entity_type),
-    tag(false)
+:   removing(false),
+    simulating(false),
+    tag(false),
+    type(default_entity_type),
+    threadSafe(false)
 {
     //                      ID
     // Handle id - used for streaming a level with hardcoded ID
@@ -84,4 +90,16 @@ void Entity::SetID(uint val)
 	_ID = val;
 	
 	nextValidID = _ID + 1;
-}
\ No newline at end of file
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Renew
+////////////////////////////////////////////////////////////////////////////////
+void Entity::Renew()
+{
+    SetID(nextValidID);
+    handle      = EntityHandle();
+    removing    = false;
+    tag         = false;
+}
@@ -13,12 +13,21 @@
 #include "tinyxml2.h"
 #include "Messaging.h"
 #include "Defines.h"
+#include "SlotMap.h"
 
 
 namespace Furiosity
 {
     enum { default_entity_type = 0 };
     
+    /// Refers to an entity in its container, goes stale once it's removed
+    typedef SlotHandle EntityHandle;
+    
+    // Fwd
+    template<class T> class EntityContainer;
+    template<class T> class EntityPool;
+    class GameWorld;
+    
     /// A base class for all things that should exist in a game world
     class Entity
     {
@@ -36,6 +45,24 @@ namespace Furiosity
 		/// the next valid ID
 		void        SetID(uint val);
         
+        /// Where the entity is in its container, set by the container
+        EntityHandle    handle;
+        
+        /// Set once the entity is queued for removal, so it gets queued once
+        bool            removing;
+        
+        /// Set while Update runs on a worker thread, in the simulate phase
+        bool            simulating;
+        
+        /// Gives a recycled entity a new ID and clears what the containers
+        /// left on it, so it can go back in as a new one
+        void            Renew();
+        
+        template<class T> friend class EntityContainer;
+        template<class T> friend class EntityCollection;
+        template<class T> friend class EntityPool;
+        friend class GameWorld;
+        
     protected:
         
         /// This is a generic flag
@@ -48,6 +75,13 @@ namespace Furiosity
         /// A name for the entity, this helps when debugging
         std::string name;
         
+        /// Set this if Update only changes the entity itself, so it can be
+        /// run on a worker thread next to other entities. Reading others and
+        /// the range queries of the world are fine. Adding, removing and
+        /// tagging entities and posting or sending messages are not, those
+        /// go in Commit.
+        bool        threadSafe;
+        
         /// Abstract class
         Entity();
 
@@ -67,9 +101,24 @@ namespace Furiosity
         /// The most important ability of an entity
         virtual void        Update(float dt)    {};
         
+        /// Called on the main thread after all the entities in the container
+        /// have been updated. Thread safe entities do anything that reaches
+        /// outside of them from here, like adding and removing entities.
+        virtual void        Commit()            {};
+        
         /// Called when the entity has been added to a container
         virtual void        Added()             {};
         
+        /// Called when the entity leaves its container for good. Return true
+        /// if the entity was kept for reuse (see EntityPool), otherwise the
+        /// container deletes it.
+        virtual bool        Recycle()           { return false; }
+        
+        /// Called instead of the dtor on an entity that is kept for reuse.
+        /// Put it back the way it was made and let go of anything the dtor
+        /// would let go of.
+        virtual void        Reset()             {};
+        
         /// Use this to grab the next valid ID
 		static uint         NextValidID()       { return nextValidID; }
 		
@@ -79,6 +128,20 @@ namespace Furiosity
 		/// Get the id of this entity
 		uint                GetID() const       { return _ID; }
         
+        /// Handle to this entity in its container. Unlike a pointer it can
+        /// be checked after the entity is gone.
+        const EntityHandle& Handle() const      { return handle; }
+        
+        /// Checks if the entity is on its way out of the container
+        bool                IsRemoved() const   { return removing; }
+        
+        /// Checks if Update can run on a worker thread
+        bool                IsThreadSafe() const { return threadSafe; }
+        
+        /// Checks if Update is running on a worker thread right now, anything
+        /// that reaches outside of the entity has to wait for Commit
+        bool                IsSimulating() const { return simulating; }
+        
         /// Get the name of this entity
         const std::string&  Name() const        { return name; }
         
@@ -0,0 +1,224 @@
+////////////////////////////////////////////////////////////////////////////////
+//  EntityCollection.h
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// STL
+#include <vector>
+#include <algorithm>
+
+// FR
+#include "Entity.h"
+#include "SlotMap.h"
+#include "EntityIndex.h"
+#include "JobSystem.h"
+#include "MessageBus.h"
+
+namespace Furiosity
+{
+    ////////////////////////////////////////////////////////////////////////////////
+    // Entity Collection
+    // The entities of a container and the way they get added, updated and
+    // removed. Both the entity container and the game world are built on it,
+    // so they go through the same queues and the same update phases.
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    class EntityCollection
+    {
+    protected:
+        /// All the entities, packed. Removing changes the order.
+        SlotMap<T*>                     entities;
+
+        /// Queue so that adding can be done form the game loop itself
+        std::vector<T*>                 addQueue;
+
+        /// Queue so that removing can be done form the game loop itself
+        std::vector<T*>                 removeQueue;
+
+        /// Finds entities by ID, name and type
+        EntityIndex<T>                  index;
+
+        /// Runs the update of thread safe entities, null when single threaded
+        JobSystem*                      jobs;
+
+        /// Below this many entities the update stays on the calling thread
+        int                             minParallelEntities;
+
+        /// Entities split for the update phase, kept to avoid allocations
+        std::vector<T*>                 simulateBuffer;
+        std::vector<T*>                 serialBuffer;
+
+        /// Messages between the entities, dispatched once per update
+        MessageBus                      messages;
+
+    public:
+        /// Ctor
+        EntityCollection() : jobs(0), minParallelEntities(256) {}
+
+        /// Sets the job system for the update, null for the calling thread only
+        /// (the default). With one, entities that are thread safe are updated
+        /// in batches over its threads, then the rest on the calling thread.
+        void SetJobSystem(JobSystem* jobSystem) { jobs = jobSystem; }
+
+        /// Number of threads for the update, including the calling one
+        int GetWorkerCount() const { return jobs ? jobs->Size() : 1; }
+
+        /// Sets the number of entities below which the update stays serial
+        void SetMinParallelEntities(int count) { minParallelEntities = count; }
+
+        /// Checks if the next update runs the thread safe entities in parallel
+        bool UpdatesInParallel() const
+        { return jobs && entities.Size() >= minParallelEntities; }
+
+        /// Entities subscribe here for the message types they care about.
+        /// Posted messages are delivered in Update, after the entities have
+        /// been updated and before the removed ones are deleted.
+        MessageBus& Messages() { return messages; }
+
+    protected:
+        /// Queues the entity for removal, once
+        void QueueRemoval(T* e);
+
+        /// Inserts the entities waiting in the add queue
+        void AddQueued();
+
+        /// Takes out the entities waiting in the remove queue and recycles or
+        /// deletes them
+        void RemoveQueued();
+
+        /// Runs the update phase, in parallel if possible, and then the
+        /// commit phase
+        void UpdateEntities(float dt);
+
+        /// Recycles or deletes all the entities, the queued ones included,
+        /// and drops the messages
+        void ClearEntities();
+    };
+
+
+    ////////////////////////////////////////////////////////////////////////////////
+    //
+    //                            - Implemetation -
+    //
+    ////////////////////////////////////////////////////////////////////////////////
+
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // QueueRemoval
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    void EntityCollection<T>::QueueRemoval(T* e)
+    {
+        // No double removes
+        if(e->removing)
+            return;
+        //
+        e->removing = true;
+        removeQueue.push_back(e);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // AddQueued
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    void EntityCollection<T>::AddQueued()
+    {
+        for (auto e : addQueue)
+        {
+            e->handle = entities.Insert(e);
+            index.Add(e);
+            e->Added();
+        }
+        addQueue.clear();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // RemoveQueued
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    void EntityCollection<T>::RemoveQueued()
+    {
+        for(auto entity : removeQueue)
+        {
+            entities.Remove(entity->handle);
+            index.Remove(entity);
+            messages.UnsubscribeAll(entity);
+            if(!entity->Recycle())
+                SafeDelete(entity);         // THIS is (not) a solution
+        }
+        removeQueue.clear();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // UpdateEntities
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    void EntityCollection<T>::UpdateEntities(float dt)
+    {
+        if(UpdatesInParallel())
+        {
+            simulateBuffer.clear();
+            serialBuffer.clear();
+            for (auto entity : entities)
+            {
+                if(entity->IsThreadSafe())
+                {
+                    entity->simulating = true;
+                    simulateBuffer.push_back(entity);
+                }
+                else
+                    serialBuffer.push_back(entity);
+            }
+
+            // Simulate phase, a few batches per thread to even out the load
+            int count = (int)simulateBuffer.size();
+            int batch = std::max(count / (jobs->Size() * 4), 1);
+            jobs->ParallelFor(count, batch, [this, dt](int from, int to)
+            {
+                for(int i = from; i < to; i++)
+                    simulateBuffer[i]->Update(dt);
+            });
+            for (auto entity : simulateBuffer)
+                entity->simulating = false;
+
+            // The rest might look at anything, so only once the workers are done
+            for (auto entity : serialBuffer)
+                entity->Update(dt);
+        }
+        else
+        {
+            for (auto entity : entities)
+                entity->Update(dt);
+        }
+
+        // Commit phase, back on this thread
+        for (auto entity : entities)
+            entity->Commit();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // ClearEntities
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    void EntityCollection<T>::ClearEntities()
+    {
+        // Clear current entities
+        for(auto e : entities)
+            if(!e->Recycle())
+                SafeDelete(e);
+        entities.Clear();
+        index.Clear();
+        messages.Clear();
+
+        // Clear enities that were to be added
+        for(auto e : addQueue)
+            if(!e->Recycle())
+                SafeDelete(e);
+        addQueue.clear();
+
+        // The ones to be removed were in one of the above, so they are gone
+        removeQueue.clear();
+    }
+}
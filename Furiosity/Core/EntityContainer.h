@@ -10,12 +10,12 @@
 
 // STL
 #include <vector>
-#include <list>
-#include <set>
 #include <functional>
+#include <algorithm>
 
 // FR
 #include "Entity.h"
+#include "EntityCollection.h"
 
 
 namespace Furiosity
@@ -23,22 +23,24 @@ namespace Furiosity
     /// A container class for all entities in the game.
     /// Base class for all game worlds (and maybe GUI)
     template<class T>
-    class EntityContainer
+    class EntityContainer : public EntityCollection<T>
     {
     protected:
         
-        typedef std::list<T*>      EntityInnerContainer;
-        typedef std::set<T*>       EntityRemoveQueue;
+        typedef SlotMap<T*>        EntityInnerContainer;
+        typedef std::vector<T*>    EntityRemoveQueue;
         typedef std::vector<T*>    EntityAddQueue;
         
-        /// All the entities in this world
-        EntityInnerContainer            entities;
-        
-        /// Queue so that adding can be done form the game loop itself
-        EntityAddQueue                  addQueue;
-        
-        /// Queue so that removing can be done form the game loop itself
-        EntityRemoveQueue               removeQueue;
+        using EntityCollection<T>::entities;
+        using EntityCollection<T>::addQueue;
+        using EntityCollection<T>::removeQueue;
+        using EntityCollection<T>::index;
+        using EntityCollection<T>::messages;
+        using EntityCollection<T>::QueueRemoval;
+        using EntityCollection<T>::AddQueued;
+        using EntityCollection<T>::RemoveQueued;
+        using EntityCollection<T>::UpdateEntities;
+        using EntityCollection<T>::ClearEntities;
         
     public:
         // Ctor
@@ -60,16 +62,28 @@ namespace Furiosity
         virtual void Commit();
         
         /// Removes and deletes all entities in this container
-        void Clear();
+        virtual void Clear();
+        
+        /// Get the entity behind a handle, null if it's gone
+        T* GetEntity(const EntityHandle& handle);
         
         /// Get a single entity with an ID
         T* GetEntityByID(int id);
         
-        /// Get the first entity with a name (names might not be unique)
-        T* GetEntityByName(std::string name);
+        /// Get an entity with a name (names might not be unique)
+        T* GetEntityByName(const std::string& name) { return index.FindByName(name); }
+        
+        /// Get an entity with an interned name, see NameTable
+        T* GetEntityByName(NameID name) { return index.FindByName(name); }
         
         /// Select entities that pass the selection filter
         std::vector<T*> SelectEntities(std::function<bool(T*)>);
+        
+        /// All the entities of exactly this type, without walking the others
+        const std::vector<T*>& SelectEntitiesOfType(int type) const { return index.OfType(type); }
+        
+        /// Select entities that have any of the type flags set
+        std::vector<T*> SelectEntitiesWithFlags(int flags) const;
 
         
         /// Select and cast entities that pass the selection filter
@@ -81,7 +95,7 @@ namespace Furiosity
         ///
         const EntityInnerContainer& Entites() const { return entities; }
         
-        /// Send a message to all entities in the container
+        /// Send a message to all entities subscribed to its type, right away
         virtual void BroadcastMessage(const Message& message) const;
     };
     
@@ -117,12 +131,7 @@ namespace Furiosity
     template<class T>
     void EntityContainer<T>::RemoveEntity(T* e)
     {
-        // No double removes
-        for (auto entity : removeQueue)
-            if(entity == e)
-                return;
-        //
-        removeQueue.insert(e);
+        QueueRemoval(e);
         
         // Let the other entities know
         // EntityDeletedMessage msg(*e);
@@ -131,29 +140,22 @@ namespace Furiosity
     
     
     ////////////////////////////////////////////////////////////////////////////////
-    // GetEntityByID
+    // GetEntity
     ////////////////////////////////////////////////////////////////////////////////
     template<class T>
-    T* EntityContainer<T>::GetEntityByID(int id)
+    T* EntityContainer<T>::GetEntity(const EntityHandle& handle)
     {
-        for(auto entity : entities)
-            if (entity->GetID() == id)
-                return entity;
-        
-        return 0;
+        T** entity = entities.Find(handle);
+        return entity ? *entity : 0;
     }
     
     ////////////////////////////////////////////////////////////////////////////////
-    // GetEntityByName
+    // GetEntityByID
     ////////////////////////////////////////////////////////////////////////////////
     template<class T>
-    T* EntityContainer<T>::GetEntityByName(std::string name)
+    T* EntityContainer<T>::GetEntityByID(int id)
     {
-        for (auto entity : entities)
-            if (entity->Name().compare(name) == 0)
-                return entity;
-        
-        return 0;
+        return index.FindByID(id);
     }
     
     
@@ -171,6 +173,21 @@ namespace Furiosity
         return selection;
     }
     
+    ////////////////////////////////////////////////////////////////////////////////
+    // Select entities with flags
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    std::vector<T*> EntityContainer<T>::SelectEntitiesWithFlags(int flags) const
+    {
+        std::vector<T*> selection;
+        index.VisitFlags(flags, [&selection](T* entity)
+        {
+            selection.push_back(entity);
+        });
+        
+        return selection;
+    }
+    
     ////////////////////////////////////////////////////////////////////////////////
     // Select and cast entities
     ////////////////////////////////////////////////////////////////////////////////
@@ -193,24 +210,16 @@ namespace Furiosity
     void EntityContainer<T>::Update(float dt)
     {
         // Add entities
-        for (auto e : addQueue)
-        {
-            entities.push_back(e);
-            e->Added();
-        }
-        addQueue.clear();
+        AddQueued();
         
         // Update entites
-        for (auto entity : entities)
-            entity->Update(dt);
+        UpdateEntities(dt);
+        
+        // Messages go out while the receivers are all still there
+        messages.Dispatch(dt);
         
         // Remove after update so that no new entities have been added
-        for(auto entity : removeQueue)
-        {
-            entities.remove(entity);        // Derefence j as it holds an pointer
-            SafeDelete(entity);             // THIS is (not) a solution
-        }
-        removeQueue.clear();
+        RemoveQueued();
     }
     
     
@@ -221,20 +230,10 @@ namespace Furiosity
     void EntityContainer<T>::Commit()
     {
         // Add entities
-        for (auto e : addQueue)
-        {
-            entities.push_back(e);
-            e->Added();
-        }
-        addQueue.clear();
+        AddQueued();
         
         // Remove after update so that no new entities have been added
-        for(auto entity : removeQueue)
-        {
-            entities.remove(entity);        // Derefence j as it holds an pointer
-            SafeDelete(entity);             // THIS is (not) a solution
-        }
-        removeQueue.clear();
+        RemoveQueued();
     }
     
     
@@ -244,20 +243,7 @@ namespace Furiosity
     template<class T>
     void EntityContainer<T>::Clear()
     {
-        // Clear current entities
-        for(auto e : entities)
-            SafeDelete(e);
-        entities.clear();
-        
-        // Clear enities that were to be added
-        for(auto e : addQueue)
-            SafeDelete(e);
-        addQueue.clear();
-        
-        // Clear remove queue
-        for(auto e : removeQueue)
-            SafeDelete(e);
-        removeQueue.clear();
+        ClearEntities();
         
         //Entity::ResetNextValidID();
     }
@@ -268,8 +254,7 @@ namespace Furiosity
     template<class T>
     void EntityContainer<T>::BroadcastMessage(const Message& message) const
     {
-        for (auto bge : entities)
-            bge->HandleMessage(message);
+        messages.Send(message);
     }
 
 }
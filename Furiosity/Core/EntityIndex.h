@@ -0,0 +1,230 @@
+////////////////////////////////////////////////////////////////////////////////
+//  EntityIndex.h
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cassert>
+
+// Local
+#include "Entity.h"
+#include "NameTable.h"
+
+namespace Furiosity
+{
+    ////////////////////////////////////////////////////////////////////////////////
+    // Entity Index
+    // Finds the entities of a container by ID, by name and by type without
+    // walking all of them. Names are hashed as they are and not interned, so
+    // the name table doesn't grow with every entity that gets spawned under a
+    // new name. Entities with the same name or the same type are kept together
+    // in buckets, so a query for a type only ever sees entities of that type.
+    // The name and the type are read when the entity is added, changing them
+    // later is not picked up.
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    class EntityIndex
+    {
+    protected:
+        typedef std::vector<T*> Bucket;
+
+        /// What the index knows about an entity
+        struct Record
+        {
+            T*                  entity;
+            const std::string*  name;
+            int                 nameSlot;
+            int                 type;
+            int                 typeSlot;
+        };
+
+        /// All entities by ID
+        std::unordered_map<uint, Record>    byID;
+
+        /// Entities with the same name, unnamed ones are left out. Records
+        /// point to the keys, which stay put while the bucket is there.
+        std::unordered_map<std::string, Bucket> byName;
+
+        /// Entities of the same type
+        std::unordered_map<int, Bucket>     byType;
+
+    public:
+        /// Adds an entity to the index, the ID must not be in use
+        void Add(T* entity);
+
+        /// Removes an entity from the index
+        void Remove(T* entity);
+
+        /// Removes all entities
+        void Clear();
+
+        /// Entity with the ID, null if there is none
+        T* FindByID(uint id) const;
+
+        /// An entity with the name, null if there is none
+        T* FindByName(const std::string& name) const;
+
+        /// An entity with an interned name, null if there is none
+        T* FindByName(NameID name) const
+        { return name ? FindByName(NameTable::Lookup(name)) : 0; }
+
+        /// All entities of exactly this type, in no particular order
+        const std::vector<T*>& OfType(int type) const;
+
+        /// Calls visitor(T*) for all entities with a type that has any of the
+        /// flags set. Only the matching buckets are walked.
+        template<class Visitor>
+        void VisitFlags(int flags, const Visitor& visitor) const;
+
+        /// Number of entities
+        int Size() const { return (int)byID.size(); }
+
+    protected:
+        /// Swap removes from a bucket, fixing the slot of the one moved
+        void Unlink(Bucket& bucket, int slot, int Record::* slotMember);
+
+        /// Shared by the empty queries
+        static const std::vector<T*>& Empty()
+        {
+            static const std::vector<T*> empty;
+            return empty;
+        }
+    };
+
+
+    ////////////////////////////////////////////////////////////////////////////////
+    //
+    //                            - Implemetation -
+    //
+    ////////////////////////////////////////////////////////////////////////////////
+
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Add
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    void EntityIndex<T>::Add(T* entity)
+    {
+        Record record;
+        record.entity   = entity;
+        record.name     = 0;
+        record.nameSlot = -1;
+        record.type     = entity->EntityType();
+
+        if(!entity->Name().empty())
+        {
+            auto names = byName.find(entity->Name());
+            if(names == byName.end())
+                names = byName.insert(std::make_pair(entity->Name(), Bucket())).first;
+            record.name     = &names->first;
+            record.nameSlot = (int)names->second.size();
+            names->second.push_back(entity);
+        }
+
+        Bucket& types = byType[record.type];
+        record.typeSlot = (int)types.size();
+        types.push_back(entity);
+
+        bool added = byID.insert(std::make_pair(entity->GetID(), record)).second;
+        assert(added);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Remove
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    void EntityIndex<T>::Remove(T* entity)
+    {
+        auto itr = byID.find(entity->GetID());
+        if(itr == byID.end() || itr->second.entity != entity)
+            return;
+
+        Record record = itr->second;
+        byID.erase(itr);
+
+        if(record.nameSlot != -1)
+        {
+            auto names = byName.find(*record.name);
+            Unlink(names->second, record.nameSlot, &Record::nameSlot);
+            if(names->second.empty())
+                byName.erase(names);
+        }
+
+        // Type buckets are few, keep them around
+        Unlink(byType[record.type], record.typeSlot, &Record::typeSlot);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Unlink
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    void EntityIndex<T>::Unlink(Bucket& bucket, int slot, int Record::* slotMember)
+    {
+        int last = (int)bucket.size() - 1;
+        if(slot != last)
+        {
+            T* moved = bucket[last];
+            bucket[slot] = moved;
+            byID[moved->GetID()].*slotMember = slot;
+        }
+        bucket.pop_back();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Clear
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    void EntityIndex<T>::Clear()
+    {
+        byID.clear();
+        byName.clear();
+        byType.clear();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // FindByID
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    T* EntityIndex<T>::FindByID(uint id) const
+    {
+        auto itr = byID.find(id);
+        return itr != byID.end() ? itr->second.entity : 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // FindByName
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    T* EntityIndex<T>::FindByName(const std::string& name) const
+    {
+        auto itr = byName.find(name);
+        return itr != byName.end() ? itr->second.front() : 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // OfType
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    const std::vector<T*>& EntityIndex<T>::OfType(int type) const
+    {
+        auto itr = byType.find(type);
+        return itr != byType.end() ? itr->second : Empty();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // VisitFlags
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    template<class Visitor>
+    void EntityIndex<T>::VisitFlags(int flags, const Visitor& visitor) const
+    {
+        for(auto& bucket : byType)
+            if(bucket.first & flags)
+                for(T* entity : bucket.second)
+                    visitor(entity);
+    }
+}
@@ -0,0 +1,243 @@
+////////////////////////////////////////////////////////////////////////////////
+//  EntityPool.h
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <cassert>
+
+namespace Furiosity
+{
+    ////////////////////////////////////////////////////////////////////////////////
+    // Entity Pool
+    // Memory and reuse for a single entity type, meant for things that get
+    // spawned a lot, like bullets and pickups. Memory comes in chunks of
+    // slots, freed slots go on a list and are handed out again, so entities
+    // of a type sit close together and spawning doesn't go to the heap.
+    //
+    // On top of that an entity can be recycled, instead of deleting it the
+    // container hands it back here reset and it can be reused as is. Make
+    // the type Pooled to have its memory come from here and to recycle it
+    // override Recycle:
+    //
+    //      class Bullet : public DynamicEntity2D, public Pooled<Bullet>
+    //      {
+    //          virtual bool Recycle() { return EntityPool<Bullet>::Instance().Recycle(this); }
+    //      };
+    //
+    // It's not thread safe, entities are made and dropped on the main thread.
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    class EntityPool
+    {
+    protected:
+        /// Memory for one entity, links to the next one while free
+        union Slot
+        {
+            Slot*   next;
+            typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type
+                    storage;
+        };
+
+        /// All the memory, never given back until the pool goes
+        std::vector<Slot*>  chunks;
+
+        /// Slots in a chunk
+        int                 chunkSize;
+
+        /// First free slot
+        Slot*               free;
+
+        /// Slots in use, recycled entities included
+        int                 allocated;
+
+        /// Entities that were reset and wait to be reused
+        std::vector<T*>     recycled;
+
+        /// Only one per type, see Instance
+        explicit EntityPool(int chunkSize);
+
+    public:
+        /// Deletes the recycled entities and frees the memory
+        ~EntityPool();
+
+        /// The pool for this type. It's never destroyed, so entities can still
+        /// be deleted during static destruction.
+        static EntityPool& Instance()
+        {
+            static EntityPool* pool = new EntityPool(64);
+            return *pool;
+        }
+
+        /// Memory for one entity
+        void* Allocate();
+
+        /// Takes back memory from Allocate
+        void Free(void* memory);
+
+        /// Resets the entity and keeps it for reuse. Returns true, so it can
+        /// be returned from an entity's Recycle.
+        bool Recycle(T* entity);
+
+        /// A recycled entity with a new ID, or null if there are none
+        T* Reuse();
+
+        /// Deletes all the recycled entities
+        void Trim();
+
+        /// Number of entities waiting to be reused
+        int RecycledCount() const   { return (int)recycled.size(); }
+
+        /// Number of slots in use
+        int AllocatedCount() const  { return allocated; }
+
+        /// Number of slots in all the chunks
+        int Capacity() const        { return (int)chunks.size() * chunkSize; }
+
+    private:
+        // Owns the memory
+        EntityPool(const EntityPool&);
+        EntityPool& operator=(const EntityPool&);
+    };
+
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Pooled
+    // Mixin that takes the memory for a type from its entity pool. Types
+    // derived from it with a different size go to the heap as usual.
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    class Pooled
+    {
+    public:
+        static void* operator new(size_t size)
+        {
+            if(size != sizeof(T))
+                return ::operator new(size);
+            return EntityPool<T>::Instance().Allocate();
+        }
+
+        static void operator delete(void* memory, size_t size)
+        {
+            if(size != sizeof(T))
+                ::operator delete(memory);
+            else
+                EntityPool<T>::Instance().Free(memory);
+        }
+    };
+
+
+    ////////////////////////////////////////////////////////////////////////////////
+    //
+    //                            - Implemetation -
+    //
+    ////////////////////////////////////////////////////////////////////////////////
+
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Ctor
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    EntityPool<T>::EntityPool(int chunkSize) :
+        chunkSize(chunkSize),
+        free(0),
+        allocated(0)
+    {
+        assert(chunkSize > 0);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Dtor
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    EntityPool<T>::~EntityPool()
+    {
+        Trim();
+        assert(allocated == 0);
+
+        for(Slot* chunk : chunks)
+            delete [] chunk;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Allocate
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    void* EntityPool<T>::Allocate()
+    {
+        if(!free)
+        {
+            // Link up a new chunk, in order so they are handed out in order
+            Slot* chunk = new Slot[chunkSize];
+            for(int i = 0; i < chunkSize - 1; i++)
+                chunk[i].next = &chunk[i + 1];
+            chunk[chunkSize - 1].next = 0;
+
+            chunks.push_back(chunk);
+            free = chunk;
+        }
+
+        Slot* slot = free;
+        free = slot->next;
+        allocated++;
+        return &slot->storage;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Free
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    void EntityPool<T>::Free(void* memory)
+    {
+        if(!memory)
+            return;
+
+        Slot* slot = static_cast<Slot*>(memory);
+        slot->next = free;
+        free = slot;
+        allocated--;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Recycle
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    bool EntityPool<T>::Recycle(T* entity)
+    {
+        entity->Reset();
+        recycled.push_back(entity);
+        return true;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Reuse
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    T* EntityPool<T>::Reuse()
+    {
+        if(recycled.empty())
+            return 0;
+
+        // Last in is the most likely to be in the cache
+        T* entity = recycled.back();
+        recycled.pop_back();
+        entity->Renew();
+        return entity;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Trim
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    void EntityPool<T>::Trim()
+    {
+        for(T* entity : recycled)
+            delete entity;
+        recycled.clear();
+    }
+}
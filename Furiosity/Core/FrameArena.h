@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////////////////////////
+//  FrameArena.h
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cassert>
+
+namespace Furiosity
+{
+    ////////////////////////////////////////////////////////////////////////////////
+    // Frame Arena
+    // Memory for things that live for a frame. Allocating bumps an offset in
+    // the current block, and everything is let go at once with Reset. Blocks
+    // are kept between frames, so once the arena has grown to fit the busiest
+    // frame it doesn't allocate anymore. Nothing is destructed, that's up to
+    // whoever put it there.
+    ////////////////////////////////////////////////////////////////////////////////
+    class FrameArena
+    {
+    protected:
+        /// A block of memory
+        struct Block
+        {
+            char*   memory;
+            size_t  size;
+        };
+
+        /// All the blocks, the ones after the current one are free
+        std::vector<Block>  blocks;
+
+        /// Block being filled
+        int                 current;
+
+        /// Bytes used in the current block
+        size_t              offset;
+
+        /// Size of a regular block
+        size_t              blockSize;
+
+    public:
+        /// Ctor, blocks are allocated on the first use
+        explicit FrameArena(size_t blockSize = 16 * 1024) :
+            current(0),
+            offset(0),
+            blockSize(blockSize)
+        {}
+
+        /// Dtor
+        ~FrameArena()
+        {
+            for(Block& block : blocks)
+                delete [] block.memory;
+        }
+
+        /// Gets memory for the rest of the frame
+        void* Allocate(size_t size, size_t alignment)
+        {
+            assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+            for(;;)
+            {
+                if(current < (int)blocks.size())
+                {
+                    Block& block = blocks[current];
+                    size_t start = (offset + alignment - 1) & ~(alignment - 1);
+                    if(start + size <= block.size)
+                    {
+                        offset = start + size;
+                        return block.memory + start;
+                    }
+
+                    // Doesn't fit, try the next one
+                    current++;
+                    offset = 0;
+                    continue;
+                }
+
+                // Out of blocks, big ones get a block of their own size
+                Block block;
+                block.size      = size + alignment > blockSize ? size + alignment : blockSize;
+                block.memory    = new char[block.size];
+                blocks.push_back(block);
+            }
+        }
+
+        /// Lets go of everything, keeping the memory
+        void Reset()
+        {
+            current = 0;
+            offset  = 0;
+        }
+
+        /// Bytes held by the arena
+        size_t Capacity() const
+        {
+            size_t total = 0;
+            for(const Block& block : blocks)
+                total += block.size;
+            return total;
+        }
+
+    private:
+        // Owns the blocks
+        FrameArena(const FrameArena&);
+        FrameArena& operator=(const FrameArena&);
+    };
+}
@@ -0,0 +1,303 @@
+////////////////////////////////////////////////////////////////////////////////
+//  JobSystem.cpp
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#include "JobSystem.h"
+
+#include <cassert>
+#include <algorithm>
+
+#include "Device.h"
+
+using namespace Furiosity;
+
+JobSystem Furiosity::gJobSystem;
+
+////////////////////////////////////////////////////////////////////////////////
+// Ctor
+////////////////////////////////////////////////////////////////////////////////
+JobSystem::JobSystem() : pending(0), quit(false)
+{
+    Initialize(1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Ctor
+////////////////////////////////////////////////////////////////////////////////
+JobSystem::JobSystem(int threadCount) : pending(0), quit(false)
+{
+    Initialize(threadCount);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Dtor
+////////////////////////////////////////////////////////////////////////////////
+JobSystem::~JobSystem()
+{
+    StopWorkers();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Initialize
+////////////////////////////////////////////////////////////////////////////////
+void JobSystem::Initialize(int threadCount)
+{
+    StopWorkers();
+
+    if(threadCount <= 0)
+        threadCount = Device::ProcessorCount();
+
+    // The calling thread has the first queue
+    threadIDs.reserve(threadCount);
+    threadIDs.push_back(std::this_thread::get_id());
+    for(int i = 0; i < threadCount; i++)
+        queues.push_back(new Queue());
+
+    quit = false;
+    for(int i = 1; i < threadCount; i++)
+    {
+        threads.push_back(std::thread(&JobSystem::WorkerLoop, this, i));
+        threadIDs.push_back(threads.back().get_id());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Shutdown
+////////////////////////////////////////////////////////////////////////////////
+void JobSystem::Shutdown()
+{
+    Initialize(1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// StopWorkers
+////////////////////////////////////////////////////////////////////////////////
+void JobSystem::StopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        quit = true;
+    }
+    wake.notify_all();
+
+    for(std::thread& t : threads)
+        t.join();
+    threads.clear();
+
+    assert(pending == 0);
+    for(Queue* q : queues)
+        delete q;
+    queues.clear();
+    threadIDs.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Create
+////////////////////////////////////////////////////////////////////////////////
+JobSystem::Job* JobSystem::Create(const JobFunction& work, Job* parent)
+{
+    Job* job        = new Job();
+    job->work       = work;
+    job->parent     = parent;
+    job->unfinished = 1;
+
+    if(parent)
+        parent->unfinished++;
+
+    return job;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Run
+////////////////////////////////////////////////////////////////////////////////
+void JobSystem::Run(Job* job)
+{
+    // Count it before it can be taken, so the count never goes below zero
+    pending++;
+
+    Queue* queue = queues[ThreadIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->jobs.push_back(job);
+    }
+
+    // Lock so a worker that is just about to sleep doesn't miss it
+    if(!threads.empty())
+    {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+        }
+        wake.notify_one();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Wait
+////////////////////////////////////////////////////////////////////////////////
+void JobSystem::Wait(Job* job)
+{
+    int index = ThreadIndex();
+    while(job->unfinished > 0)
+    {
+        Job* next = GetJob(index);
+        if(next)
+            Execute(next);
+        else
+            std::this_thread::yield();
+    }
+
+    delete job;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ParallelFor
+////////////////////////////////////////////////////////////////////////////////
+void JobSystem::ParallelFor(int count, int batchSize, const RangeFunction& body)
+{
+    if(count <= 0)
+        return;
+
+    if(batchSize < 1)
+        batchSize = 1;
+
+    // Nobody to share with
+    if(threads.empty() || count <= batchSize)
+    {
+        body(0, count);
+        return;
+    }
+
+    Job* root = Create(JobFunction());
+    for(int from = 0; from < count; from += batchSize)
+    {
+        int to = std::min(from + batchSize, count);
+        Run(Create([&body, from, to] { body(from, to); }, root));
+    }
+    Run(root);
+    Wait(root);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// RunOnMainThread
+////////////////////////////////////////////////////////////////////////////////
+void JobSystem::RunOnMainThread(const JobFunction& work)
+{
+    std::lock_guard<std::mutex> lock(mainMutex);
+    mainQueue.push_back(work);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ProcessMainThreadJobs
+////////////////////////////////////////////////////////////////////////////////
+void JobSystem::ProcessMainThreadJobs()
+{
+    assert(IsMainThread());
+
+    {
+        std::lock_guard<std::mutex> lock(mainMutex);
+        mainBuffer.swap(mainQueue);
+    }
+
+    for(JobFunction& work : mainBuffer)
+        work();
+    mainBuffer.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// WorkerLoop
+////////////////////////////////////////////////////////////////////////////////
+void JobSystem::WorkerLoop(int index)
+{
+    for(;;)
+    {
+        Job* job = GetJob(index);
+        if(job)
+        {
+            Execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wake.wait(lock, [this] { return quit || pending > 0; });
+        if(quit)
+            return;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ThreadIndex
+////////////////////////////////////////////////////////////////////////////////
+int JobSystem::ThreadIndex() const
+{
+    // Just a handful of threads, a walk is fine
+    std::thread::id id = std::this_thread::get_id();
+    for(int i = 1; i < (int)threadIDs.size(); i++)
+        if(threadIDs[i] == id)
+            return i;
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// GetJob
+////////////////////////////////////////////////////////////////////////////////
+JobSystem::Job* JobSystem::GetJob(int index)
+{
+    if(pending <= 0)
+        return 0;
+
+    // Own queue first, newest job is the most likely to be in the cache
+    Job* job = 0;
+    {
+        Queue* queue = queues[index];
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        if(!queue->jobs.empty())
+        {
+            job = queue->jobs.back();
+            queue->jobs.pop_back();
+        }
+    }
+
+    // Steal the oldest, it's likely the biggest chunk of work
+    for(int i = 1; !job && i < (int)queues.size(); i++)
+    {
+        Queue* queue = queues[(index + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        if(!queue->jobs.empty())
+        {
+            job = queue->jobs.front();
+            queue->jobs.pop_front();
+        }
+    }
+
+    if(job)
+        pending--;
+    return job;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Execute
+////////////////////////////////////////////////////////////////////////////////
+void JobSystem::Execute(Job* job)
+{
+    if(job->work)
+        job->work();
+    Finish(job);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Finish
+////////////////////////////////////////////////////////////////////////////////
+void JobSystem::Finish(Job* job)
+{
+    // Once the count hits zero a waiter might release the job, so read
+    // everything needed before
+    Job* parent = job->parent;
+    if(--job->unfinished == 0 && parent)
+    {
+        Finish(parent);
+        delete job;
+    }
+}
+
+// end
@@ -0,0 +1,163 @@
+////////////////////////////////////////////////////////////////////////////////
+//  JobSystem.h
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+#include "Defines.h"
+
+namespace Furiosity
+{
+    ////////////////////////////////////////////////////////////////////////////////
+    // Job System
+    // Runs small jobs over a fixed set of worker threads. Each thread has its
+    // own queue, it takes the newest job from its own queue and when that runs
+    // dry, it steals the oldest one from another. A job can have a parent,
+    // the parent is only done once all of its children are done, so waiting
+    // on the parent waits on the whole tree. Waiting doesn't block, the
+    // waiting thread runs other jobs in the meantime.
+    //
+    // The thread that initializes the system is the main thread. It has a
+    // queue of its own for work that has to run there, like anything with GL.
+    //
+    // Until it's initialized the system has no workers and everything runs
+    // on the thread that waits.
+    ////////////////////////////////////////////////////////////////////////////////
+    class JobSystem
+    {
+    public:
+        typedef std::function<void()>           JobFunction;
+        typedef std::function<void(int, int)>   RangeFunction;
+
+        /// A unit of work, made with Create and released with Wait
+        struct Job
+        {
+            /// The work itself, can be empty for jobs that only group others
+            JobFunction         work;
+
+            /// Job that waits on this one, if any
+            Job*                parent;
+
+            /// This job plus its children that are not done yet
+            std::atomic<int>    unfinished;
+        };
+
+    protected:
+        /// Jobs of a single thread
+        struct Queue
+        {
+            std::mutex          mutex;
+            std::deque<Job*>    jobs;
+        };
+
+        /// The worker threads
+        std::vector<std::thread>        threads;
+
+        /// Thread ids, the main thread is at zero and the workers follow
+        std::vector<std::thread::id>    threadIDs;
+
+        /// One queue per thread, in the same order as the ids
+        std::vector<Queue*>             queues;
+
+        /// Number of jobs in all the queues
+        std::atomic<int>                pending;
+
+        /// Idle workers sleep on this
+        std::mutex                      wakeMutex;
+        std::condition_variable         wake;
+
+        /// Set when the workers should go away
+        bool                            quit;
+
+        /// Work for the main thread
+        std::mutex                      mainMutex;
+        std::vector<JobFunction>        mainQueue;
+        std::vector<JobFunction>        mainBuffer;
+
+    public:
+        /// Creates the system without any workers
+        JobSystem();
+
+        /// Creates the system with this many threads, see Initialize
+        explicit JobSystem(int threadCount);
+
+        /// Stops the workers
+        ~JobSystem();
+
+        /// Starts the workers. The count includes the calling thread, which
+        /// becomes the main thread. Zero takes one thread per processor.
+        void Initialize(int threadCount = 0);
+
+        /// Stops the workers, all the jobs must be done. Jobs can still be
+        /// used afterwards, they just run on the thread that waits.
+        void Shutdown();
+
+        /// Number of threads running jobs, including the main one
+        int Size() const { return (int)threadIDs.size(); }
+
+        /// Makes a job. If it has a parent, the parent won't be done before
+        /// this one is. Nothing runs before the job is handed to Run.
+        Job* Create(const JobFunction& work, Job* parent = 0);
+
+        /// Queues a job on the calling thread's queue
+        void Run(Job* job);
+
+        /// Runs other jobs until this one and its children are done, then
+        /// releases it. Every job without a parent must be waited on, the
+        /// ones with a parent are released when they finish.
+        void Wait(Job* job);
+
+        /// Splits [0, count) in batches of batchSize and calls body(from, to)
+        /// for each, over all the threads. Returns once all are done.
+        void ParallelFor(int count, int batchSize, const RangeFunction& body);
+
+        /// Queues work for the main thread, safe to call from any thread
+        void RunOnMainThread(const JobFunction& work);
+
+        /// Runs the work queued for the main thread, call it from the main
+        /// thread once a frame. Work queued in the meantime waits for the
+        /// next call.
+        void ProcessMainThreadJobs();
+
+        /// Checks if the calling thread is the main one
+        bool IsMainThread() const { return std::this_thread::get_id() == threadIDs[0]; }
+
+        /// Index of the calling thread, below Size. Threads that are not ours
+        /// get zero, like the main one.
+        int ThreadIndex() const;
+
+    protected:
+        /// Joins the workers and drops the queues
+        void StopWorkers();
+
+        /// Worker thread loop
+        void WorkerLoop(int index);
+
+        /// Takes the newest job from this thread's queue or steals the oldest
+        /// one from another queue. Null if there are none.
+        Job* GetJob(int index);
+
+        /// Runs a job and lets its parents know
+        void Execute(Job* job);
+
+        /// Marks one more part of the job done
+        void Finish(Job* job);
+
+    private:
+        // Owns the threads
+        JobSystem(const JobSystem&);
+        JobSystem& operator=(const JobSystem&);
+    };
+
+    /// The one shared by the engine, initialized by the general manager
+    extern JobSystem gJobSystem;
+}
@@ -0,0 +1,153 @@
+////////////////////////////////////////////////////////////////////////////////
+//  MessageBus.cpp
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#include "MessageBus.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "Entity.h"
+
+using namespace Furiosity;
+
+////////////////////////////////////////////////////////////////////////////////
+// Subscribe
+////////////////////////////////////////////////////////////////////////////////
+void MessageBus::Subscribe(int type, Entity* receiver)
+{
+    assert(type >= 0);
+
+    std::vector<int>& types = subscriptions[receiver];
+    if(std::find(types.begin(), types.end(), type) != types.end())
+        return;
+    types.push_back(type);
+
+    if(type >= (int)receivers.size())
+        receivers.resize(type + 1);
+    receivers[type].push_back(receiver);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Unsubscribe
+////////////////////////////////////////////////////////////////////////////////
+void MessageBus::Unsubscribe(int type, Entity* receiver)
+{
+    auto itr = subscriptions.find(receiver);
+    if(itr == subscriptions.end())
+        return;
+
+    std::vector<int>& types = itr->second;
+    auto t = std::find(types.begin(), types.end(), type);
+    if(t == types.end())
+        return;
+    types.erase(t);
+    if(types.empty())
+        subscriptions.erase(itr);
+
+    // Keep the order, receivers get messages in the order they subscribed
+    ReceiverList& list = receivers[type];
+    list.erase(std::find(list.begin(), list.end(), receiver));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// UnsubscribeAll
+////////////////////////////////////////////////////////////////////////////////
+void MessageBus::UnsubscribeAll(Entity* receiver)
+{
+    auto itr = subscriptions.find(receiver);
+    if(itr == subscriptions.end())
+        return;
+
+    for(int type : itr->second)
+    {
+        ReceiverList& list = receivers[type];
+        list.erase(std::find(list.begin(), list.end(), receiver));
+    }
+    subscriptions.erase(itr);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Send
+////////////////////////////////////////////////////////////////////////////////
+void MessageBus::Send(const Message& message) const
+{
+    int type = message.Type();
+    if(type < 0 || type >= (int)receivers.size())
+        return;
+
+    // Goes to the receivers subscribed when it was sent. Handlers can
+    // subscribe, unsubscribe and send themselves, so the list is copied to the
+    // end of a stack that nested sends grow and shrink.
+    const ReceiverList& list = receivers[type];
+    size_t begin = sending.size();
+    sending.insert(sending.end(), list.begin(), list.end());
+    size_t end = sending.size();
+    for(size_t i = begin; i < end; i++)
+        sending[i]->HandleMessage(message);
+    sending.resize(begin);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Dispatch
+////////////////////////////////////////////////////////////////////////////////
+void MessageBus::Dispatch(float dt)
+{
+    // Pull out the delayed ones that are due, keeping the order
+    due.clear();
+    int kept = 0;
+    for(size_t i = 0; i < delayed.size(); i++)
+    {
+        delayed[i].time -= dt;
+        if(delayed[i].time <= 0.0f)
+            due.push_back(delayed[i].message);
+        else
+            delayed[kept++] = delayed[i];
+    }
+    delayed.resize(kept);
+
+    // Anything posted from here on goes to the other queue
+    int queue = current;
+    current ^= 1;
+
+    for(Message* message : due)
+    {
+        Send(*message);
+        delete message;
+    }
+
+    for(Message* message : queues[queue])
+        Send(*message);
+    Release(queue);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Clear
+////////////////////////////////////////////////////////////////////////////////
+void MessageBus::Clear()
+{
+    Release(0);
+    Release(1);
+
+    for(DelayedMessage& entry : delayed)
+        delete entry.message;
+    delayed.clear();
+
+    receivers.clear();
+    subscriptions.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Release
+////////////////////////////////////////////////////////////////////////////////
+void MessageBus::Release(int queue)
+{
+    // The memory goes with the arena, only the dtor is needed
+    for(Message* message : queues[queue])
+        message->~Message();
+    queues[queue].clear();
+    arenas[queue].Reset();
+}
+
+// end
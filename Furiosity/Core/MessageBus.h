@@ -0,0 +1,147 @@
+////////////////////////////////////////////////////////////////////////////////
+//  MessageBus.h
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <new>
+#include <type_traits>
+
+// Local
+#include "Messaging.h"
+#include "FrameArena.h"
+
+namespace Furiosity
+{
+    class Entity;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Message Bus
+    // Delivers messages only to the entities that subscribed to their type.
+    // Send delivers right away. Post copies the message into a frame arena and
+    // it gets delivered with the rest of the frame in Dispatch. Posted
+    // messages can also be delayed, those are kept until they are due.
+    // Messages posted while dispatching go out with the next dispatch.
+    // It's meant to be used from the main thread.
+    ////////////////////////////////////////////////////////////////////////////////
+    class MessageBus
+    {
+    protected:
+        /// Entities that receive a type
+        typedef std::vector<Entity*> ReceiverList;
+
+        /// A message waiting for its time
+        struct DelayedMessage
+        {
+            Message*    message;
+            float       time;
+        };
+
+        /// Receivers for each message type, indexed by type
+        std::vector<ReceiverList>                           receivers;
+
+        /// Types each entity subscribed to, so it can be dropped quickly
+        std::unordered_map<Entity*, std::vector<int>>       subscriptions;
+
+        /// Posted messages and the memory they live in. Two of each, so that
+        /// posting while dispatching doesn't touch the ones being delivered.
+        std::vector<Message*>                               queues[2];
+        FrameArena                                          arenas[2];
+
+        /// The queue taking posts
+        int                                                 current;
+
+        /// Messages that were posted with a delay
+        std::vector<DelayedMessage>                         delayed;
+
+        /// Delayed messages that are due, reused
+        std::vector<Message*>                               due;
+
+        /// Receivers of the messages being sent, reused
+        mutable ReceiverList                                sending;
+
+    public:
+        /// Ctor
+        MessageBus() : current(0) {}
+
+        /// Drops everything
+        ~MessageBus() { Clear(); }
+
+        /// Have the entity receive messages of this type
+        void Subscribe(int type, Entity* receiver);
+
+        /// Stop the entity from receiving messages of this type
+        void Unsubscribe(int type, Entity* receiver);
+
+        /// Drops all subscriptions of the entity, call before it's deleted
+        void UnsubscribeAll(Entity* receiver);
+
+        /// Delivers the message right away to all the subscribers
+        void Send(const Message& message) const;
+
+        /// Queues a copy of the message for the next dispatch, or for the
+        /// first dispatch after the delay (in seconds) has passed
+        template<class M>
+        void Post(const M& message, float delay = 0.0f);
+
+        /// Delivers the delayed messages that are due and all the posted ones,
+        /// then frees them
+        void Dispatch(float dt);
+
+        /// Drops all the subscriptions and the messages that were not
+        /// delivered yet
+        void Clear();
+
+        /// Number of entities subscribed to a type
+        int ReceiverCount(int type) const
+        {
+            return type >= 0 && type < (int)receivers.size() ? (int)receivers[type].size() : 0;
+        }
+
+        /// Number of messages waiting for the next dispatch, not counting the
+        /// delayed ones
+        int QueuedCount() const { return (int)queues[current].size(); }
+
+        /// Number of delayed messages
+        int DelayedCount() const { return (int)delayed.size(); }
+
+    protected:
+        /// Destructs the messages in a queue and resets its arena
+        void Release(int queue);
+
+    private:
+        // Owns the messages
+        MessageBus(const MessageBus&);
+        MessageBus& operator=(const MessageBus&);
+    };
+
+
+    ////////////////////////////////////////////////////////////////////////////////
+    //
+    //                            - Implemetation -
+    //
+    ////////////////////////////////////////////////////////////////////////////////
+
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Post
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class M>
+    void MessageBus::Post(const M& message, float delay)
+    {
+        static_assert(std::is_base_of<Message, M>::value, "Only messages can be posted");
+
+        if(delay > 0.0f)
+        {
+            DelayedMessage entry = { new M(message), delay };
+            delayed.push_back(entry);
+            return;
+        }
+
+        void* memory = arenas[current].Allocate(sizeof(M), std::alignment_of<M>::value);
+        queues[current].push_back(new (memory) M(message));
+    }
+}
@@ -0,0 +1,83 @@
+////////////////////////////////////////////////////////////////////////////////
+//  NameTable.cpp
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#include "NameTable.h"
+
+#include <vector>
+#include <unordered_map>
+#include <cassert>
+
+using namespace Furiosity;
+
+namespace
+{
+    // Kept in a function so that other statics can intern names
+    struct Table
+    {
+        std::unordered_map<std::string, NameID> ids;
+        std::vector<const std::string*>         names;
+
+        Table()
+        {
+            // The empty name is always zero
+            names.push_back(&ids.insert(std::make_pair(std::string(), 0)).first->first);
+        }
+    };
+
+    Table& GetTable()
+    {
+        static Table table;
+        return table;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Intern
+////////////////////////////////////////////////////////////////////////////////
+NameID NameTable::Intern(const std::string& name)
+{
+    Table& table = GetTable();
+
+    auto itr = table.ids.find(name);
+    if(itr != table.ids.end())
+        return itr->second;
+
+    // Keys in the map don't move, so the name can be pointed to
+    NameID id = (NameID)table.names.size();
+    itr = table.ids.insert(std::make_pair(name, id)).first;
+    table.names.push_back(&itr->first);
+    return id;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Find
+////////////////////////////////////////////////////////////////////////////////
+NameID NameTable::Find(const std::string& name)
+{
+    Table& table = GetTable();
+
+    auto itr = table.ids.find(name);
+    return itr != table.ids.end() ? itr->second : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Lookup
+////////////////////////////////////////////////////////////////////////////////
+const std::string& NameTable::Lookup(NameID id)
+{
+    Table& table = GetTable();
+    assert(id < table.names.size());
+    return *table.names[id];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Size
+////////////////////////////////////////////////////////////////////////////////
+int NameTable::Size()
+{
+    return (int)GetTable().names.size();
+}
+
+// end
@@ -0,0 +1,42 @@
+////////////////////////////////////////////////////////////////////////////////
+//  NameTable.h
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+
+// Local
+#include "Defines.h"
+
+namespace Furiosity
+{
+    /// An interned name. Two names are the same if their ids are the same,
+    /// zero stands for the empty name.
+    typedef uint NameID;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Name Table
+    // Hands out a unique id for each string, so names can be kept and compared
+    // as integers. The table only grows, an id stays good for the life of the
+    // program. It's meant to be used from the main thread.
+    ////////////////////////////////////////////////////////////////////////////////
+    class NameTable
+    {
+    public:
+        /// Gets the id of a name, adding it to the table the first time
+        static NameID Intern(const std::string& name);
+
+        /// Gets the id of a name without adding it, zero if it was never
+        /// interned. Use this for lookups, so that looking for a name that
+        /// doesn't exist doesn't grow the table.
+        static NameID Find(const std::string& name);
+
+        /// Gets the name behind an id
+        static const std::string& Lookup(NameID id);
+
+        /// Number of names in the table
+        static int Size();
+    };
+}
@@ -0,0 +1,204 @@
+////////////////////////////////////////////////////////////////////////////////
+//  SlotMap.h
+//  Furiosity
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <cassert>
+
+// Local
+#include "Defines.h"
+
+namespace Furiosity
+{
+    ///
+    /// Refers to an item in a slot map. The generation changes every time the
+    /// slot is reused, so a handle to a removed item can be told apart from a
+    /// handle to whatever took its place. The default handle refers to nothing.
+    ///
+    struct SlotHandle
+    {
+        /// Slot in the map
+        uint Index;
+
+        /// Generation of the slot when the handle was made, never zero for
+        /// a valid handle
+        uint Generation;
+
+        SlotHandle() : Index(0), Generation(0) {}
+
+        SlotHandle(uint index, uint generation) : Index(index), Generation(generation) {}
+
+        /// Checks if the handle was ever given out, not if it's still alive
+        bool IsValid() const { return Generation != 0; }
+
+        bool operator==(const SlotHandle& other) const
+        {
+            return Index == other.Index && Generation == other.Generation;
+        }
+
+        bool operator!=(const SlotHandle& other) const { return !(*this == other); }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Slot Map
+    // Keeps the items packed in one array, so iterating is a walk over memory.
+    // Removing moves the last item into the hole, which makes it constant time
+    // but changes the order. Items are reached through handles that stay good
+    // no matter how the items move, and go stale once the item is removed.
+    ////////////////////////////////////////////////////////////////////////////////
+    template<class T>
+    class SlotMap
+    {
+    public:
+        typedef typename std::vector<T>::iterator          iterator;
+        typedef typename std::vector<T>::const_iterator    const_iterator;
+
+    protected:
+        /// Where a handle leads
+        struct Slot
+        {
+            /// Index of the item, or the next free slot if the slot is free
+            uint    item;
+
+            /// Bumped every time the item is removed
+            uint    generation;
+        };
+
+        /// The items, packed
+        std::vector<T>      items;
+
+        /// For each item, the slot that points to it
+        std::vector<uint>   owners;
+
+        /// All the slots, free ones are chained through item
+        std::vector<Slot>   slots;
+
+        /// Head of the free slot chain
+        uint                freeList;
+
+        /// Marks the end of the free chain
+        enum { NoSlot = 0xffffffff };
+
+    public:
+        /// Ctor
+        SlotMap() : freeList(NoSlot) {}
+
+        /// Adds an item and returns a handle to it
+        SlotHandle Insert(const T& item)
+        {
+            uint index;
+            if(freeList != NoSlot)
+            {
+                index = freeList;
+                freeList = slots[index].item;
+            }
+            else
+            {
+                index = (uint)slots.size();
+                Slot slot = { 0, 1 };
+                slots.push_back(slot);
+            }
+
+            slots[index].item = (uint)items.size();
+            items.push_back(item);
+            owners.push_back(index);
+            return SlotHandle(index, slots[index].generation);
+        }
+
+        /// Removes the item, moving the last one in its place. Returns false
+        /// if the handle is stale. The removed item is copied out if asked.
+        bool Remove(const SlotHandle& handle, T* removed = 0)
+        {
+            if(!Contains(handle))
+                return false;
+
+            Slot& slot = slots[handle.Index];
+            uint hole = slot.item;
+            uint last = (uint)items.size() - 1;
+            if(removed)
+                *removed = items[hole];
+
+            // Fill the hole with the last one
+            if(hole != last)
+            {
+                items[hole]     = items[last];
+                owners[hole]    = owners[last];
+                slots[owners[hole]].item = hole;
+            }
+            items.pop_back();
+            owners.pop_back();
+
+            // Never hand out generation zero
+            if(++slot.generation == 0)
+                slot.generation = 1;
+            slot.item   = freeList;
+            freeList    = handle.Index;
+            return true;
+        }
+
+        /// Checks if the handle leads to an item
+        bool Contains(const SlotHandle& handle) const
+        {
+            return handle.Index < slots.size() &&
+                   handle.Generation != 0 &&
+                   slots[handle.Index].generation == handle.Generation;
+        }
+
+        /// Gets the item for a handle, null if the handle is stale
+        T* Find(const SlotHandle& handle)
+        {
+            return Contains(handle) ? &items[slots[handle.Index].item] : 0;
+        }
+
+        /// Gets the item for a handle, null if the handle is stale
+        const T* Find(const SlotHandle& handle) const
+        {
+            return Contains(handle) ? &items[slots[handle.Index].item] : 0;
+        }
+
+        /// Drops all the items, all handles go stale
+        void Clear()
+        {
+            for(uint i = 0; i < owners.size(); i++)
+            {
+                Slot& slot = slots[owners[i]];
+                if(++slot.generation == 0)
+                    slot.generation = 1;
+                slot.item   = freeList;
+                freeList    = owners[i];
+            }
+            items.clear();
+            owners.clear();
+        }
+
+        /// Makes room up front
+        void Reserve(int count)
+        {
+            items.reserve(count);
+            owners.reserve(count);
+            slots.reserve(count);
+        }
+
+        /// Number of items
+        int Size() const { return (int)items.size(); }
+
+        /// Checks if there are no items
+        bool Empty() const { return items.empty(); }
+
+        /// The items, packed and in no particular order
+        const std::vector<T>& Items() const { return items; }
+
+        /// Item by position in the packed array
+        T& operator[](int i)                { return items[i]; }
+        const T& operator[](int i) const    { return items[i]; }
+
+        /// Iterators for ranged loops
+        iterator begin()                    { return items.begin(); }
+        iterator end()                      { return items.end(); }
+        const_iterator begin() const        { return items.begin(); }
+        const_iterator end() const          { return items.end(); }
+    };
+}
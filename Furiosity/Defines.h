@@ -31,6 +31,7 @@ namespace Furiosity
 {
     typedef unsigned int    uint;
     typedef unsigned short  ushort;
+    typedef unsigned long long uint64;
     // typedef unsigned long   ulong;
     
     // A macro to call pointers to member functions
@@ -13,6 +13,7 @@ using namespace Furiosity;
 
 Entity3D::Entity3D(World3D* world, Entity3D* parent, float radius) :
     radius(radius),
+    localScale(1.0f, 1.0f, 1.0f),
     world3D(world)
 {
     if(parent != nullptr)
@@ -24,7 +25,17 @@ Entity3D::Entity3D(World3D* world, Entity3D* parent, float radius) :
 
 void Entity3D::Update(float dt)
 {
-    UpdateTransform();
+    // Only this one, the children get theirs in their own update
+    if(worldDirty)
+        ResolveTransform();
+}
+
+void Entity3D::Reset()
+{
+    enabled = true;
+    localTrns.SetIdentity();
+    localScale = Vector3(1.0f, 1.0f, 1.0f);
+    InvalidateTransform();
 }
 
 void Entity3D::SetEnabled(bool enabled, bool recursive)
@@ -30,7 +30,15 @@ namespace Furiosity
         
         Matrix44                localTrns;
         
-        Matrix44                worldTrns;
+        /// Computed from the parents when read, see Transform
+        mutable Matrix44        worldTrns;
+        
+        /// Set when the world transform needs to be computed again
+        mutable bool            worldDirty  = true;
+        
+        /// Scale of the local transform, kept so it's not taken apart
+        /// every time it's needed
+        Vector3                 localScale;
         
         Entity3D*               parent      = nullptr;
         
@@ -48,6 +56,10 @@ namespace Furiosity
         
         virtual void Update(float dt) override;
         
+        /// Back to an enabled entity at the parent's origin, the hierarchy
+        /// is left as is
+        virtual void Reset() override;
+        
         bool Enabled() const { return enabled; }
         
         void SetEnabled(bool enabled, bool recursive = true);
@@ -70,33 +82,38 @@ namespace Furiosity
         /// Do debug rendering of this entity
         virtual void DebugRender();
         
-        /// Update the trasform of the entity
+        /// Brings the world transform of the entity and its subtree up to
+        /// date. Reading the transform does this anyway, so this is only
+        /// needed to get it done at a set time, like once per frame.
         inline void UpdateTransform()
         {
-            if(parent)
-                //worldTrns = localTrns * parent->worldTrns;
-                worldTrns =  parent->worldTrns * localTrns;
-            else
-                worldTrns = localTrns;
+            if(worldDirty)
+                ResolveTransform();
             
             for(auto c : childern)
                 c->UpdateTransform();
         }
         
         /// Get the world transormation of this entity
-        inline Matrix44 Transform() const { return worldTrns; }
+        inline const Matrix44& Transform() const
+        {
+            if(worldDirty)
+                ResolveTransform();
+            return worldTrns;
+        }
         
         /// Get only the orientation part of the world matrix
-        inline Matrix33 Orientation() const { return worldTrns.GetMatrix33(); }
+        inline Matrix33 Orientation() const { return Transform().GetMatrix33(); }
         
         /// Get the world position
-        inline Vector3 Position() const { return worldTrns.Translation(); }
+        inline Vector3 Position() const { return Transform().Translation(); }
 
         /// Set the local transformation
         inline void SetTransformation(const Matrix44& trans)
         {
             localTrns = trans;
-            UpdateTransform();
+            localScale = ExtractScale();
+            InvalidateTransform();
         }
         
         ///
@@ -110,18 +127,18 @@ namespace Furiosity
             }
             else
             {
-                Vector3 wPos = worldTrns.Translation();
+                Vector3 wPos = Transform().Translation();
                 Vector3 lPos = localTrns.Translation();
                 localTrns.SetTranslation(position + (wPos - lPos));
             }
             
-            UpdateTransform();
+            InvalidateTransform();
         }
         
         /// Get the local position
         inline Vector3 LocalPosition() const
         {
-            return worldTrns.Translation();
+            return localTrns.Translation();
         }
         
         
@@ -129,31 +146,21 @@ namespace Furiosity
         inline void SetLocalPosition(Vector3 position)
         {
             localTrns.SetTranslation(position);
-            UpdateTransform();
+            InvalidateTransform();
         }
         
         /// Gets the local scale. Might be non uniform.
-        inline Vector3 LocalScale() const
-        {
-            // Extract the orientation vectors
-            const Matrix44& trns = localTrns;
-            Vector3 x(trns.m00, trns.m01, trns.m02);
-            Vector3 y(trns.m10, trns.m11, trns.m12);
-            Vector3 z(trns.m20, trns.m21, trns.m22);
-            
-            // Get their scale
-            return Vector3(x.Magnitude(), y.Magnitude(), z.Magnitude());
-        }
+        inline Vector3 LocalScale() const { return localScale; }
         
         /// Set the local scale. Might accumulate errors over time.
         inline void SetLocalScale(Vector3 scale)
         {
-            Vector3 currentScale = LocalScale();
-            Vector3 relativeScale(scale.x / currentScale.x,
-                                  scale.y / currentScale.y,
-                                  scale.z / currentScale.z);
+            Vector3 relativeScale(scale.x / localScale.x,
+                                  scale.y / localScale.y,
+                                  scale.z / localScale.z);
             localTrns = localTrns * Matrix44::CreateScale(relativeScale);
-            UpdateTransform();
+            localScale = scale;
+            InvalidateTransform();
         }
         
         /// Set the local orientation.
@@ -161,11 +168,47 @@ namespace Furiosity
                                         const Vector3& y,
                                         const Vector3& z)
         {
-            Vector3 scale = LocalScale();
-            localTrns.SetOrientation(x * scale.x,
-                                     y * scale.y,
-                                     z * scale.z);
-            UpdateTransform();
+            localTrns.SetOrientation(x * localScale.x,
+                                     y * localScale.y,
+                                     z * localScale.z);
+            InvalidateTransform();
+        }
+        
+    protected:
+        /// Marks the world transform of the entity and its subtree as out of
+        /// date. A dirty entity only has dirty children, so it stops there.
+        inline void InvalidateTransform()
+        {
+            if(worldDirty)
+                return;
+            
+            worldDirty = true;
+            for(auto c : childern)
+                c->InvalidateTransform();
+        }
+        
+        /// Computes the world transform from the parent's
+        inline void ResolveTransform() const
+        {
+            if(parent)
+                //worldTrns = localTrns * parent->worldTrns;
+                worldTrns = parent->Transform() * localTrns;
+            else
+                worldTrns = localTrns;
+            
+            worldDirty = false;
+        }
+        
+        /// Gets the scale from the local transform, the slow way
+        inline Vector3 ExtractScale() const
+        {
+            // Lengths of the orientation vectors
+            const Matrix44& trns = localTrns;
+            Vector3 x(trns.m00, trns.m01, trns.m02);
+            Vector3 y(trns.m10, trns.m11, trns.m12);
+            Vector3 z(trns.m20, trns.m21, trns.m22);
+            
+            return Vector3(x.Magnitude(), y.Magnitude(), z.Magnitude());
         }
     };
 }
\ No newline at end of file
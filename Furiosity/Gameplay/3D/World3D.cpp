@@ -39,58 +39,74 @@ void World3D::Update(float dt)
 {
     EntityContainer::Update(dt);
     
-    vector<Entity3D*> colliders;
+    broadphase.Update(entities.Items());
+    AccumulateContacts();
+    ResolveContacts();
+}
+
+void World3D::Clear()
+{
+    EntityContainer::Clear();
     
-    for(Entity3D* e : entities)
-        if (e->BoundingRadius() > 0 )
-            colliders.push_back(e);    
+    // The proxies point to the entities that are gone now
+    broadphase.Clear();
+    contacts.clear();
+}
+
+void World3D::AccumulateContacts()
+{
+    contacts.clear();
     
-    for (int i = 0; i < colliders.size() - 1; i++)
+    broadphase.VisitPairs([&](Entity3D* e0, Entity3D* e1)
     {
-        for (int  j = i + 1; j < colliders.size(); j++)
+        // Use squre val to skip sqrt on the ones that don't touch
+        Vector3 normal = e0->Position() - e1->Position();
+        float distSq = normal.SquareMagnitude();
+        float radiussum = e0->BoundingRadius() + e1->BoundingRadius();
+        if(distSq >= radiussum * radiussum)
+            return;
+        
+        // Always order them in a way that is predicable for the
+        // event handling. Smaller type goes first
+        if(e0->EntityType() > e1->EntityType())
         {
-            // Get the entities
-            Entity3D* e0 = colliders[i];
-            Entity3D* e1 = colliders[j];
+            swap(e0, e1);
+            normal *= -1.0f;
+        }
+        
+        // Right on top of each other, any direction will do
+        float dist = sqrtf(distSq);
+        if(dist > 0.0f)
+            normal *= 1.0f / dist;
+        else
+            normal = Vector3(0.0f, 1.0f, 0.0f);
+        
+        contacts.push_back(Contact3D(e0, e1, 0.0f, normal, radiussum - dist));
+    });
+}
+
+void World3D::ResolveContacts()
+{
+    for(Contact3D& contact : contacts)
+    {
+        HandleCollision(contact);
+        
+        // Very, very, very crude collision resolving
+        if(!contact.Resolved)
+        {
+            Entity3D& first  = *contact.FirstBody;
+            Entity3D& second = *contact.SecondBody;
+        
+            // The movement of each object is based on inverse mass, so total that
+            float totalRadius = first.BoundingRadius() + second.BoundingRadius();
+            
+            Vector3 move = contact.ContactNormal * contact.Penetration;
             
-            // Always order them in a way that is predicable for the
-            // event handling. Smaller type goes first
-            if(e0->EntityType() > e1->EntityType())
-                swap(e0, e1);
+            Vector3 moveFst = move * (-first.BoundingRadius() / totalRadius);
+            Vector3 moveSec = move * (second.BoundingRadius() / totalRadius);
             
-            Vector3 normal = e0->Position() - e1->Position();
-            float dist = normal.Magnitude();
-            float radiussum = e0->BoundingRadius() + e1->BoundingRadius();
-            if(dist < radiussum)
-            {
-                
-                // Vector3 pos = (c0->Position() + c1->Position()) * 0.5f;
-                normal.Normalize();
-                float diff = radiussum - dist;
-                Contact3D contact(e0, e1, 0.0f, normal, diff	);
-                
-                //LOG("Collision! \n");
-                
-                HandleCollision(contact);
-                
-                // Very, very, very crude collision resolving
-                if(!contact.Resolved)
-                {
-                    Entity3D& first  = *contact.FirstBody;
-                    Entity3D& second = *contact.SecondBody;
-                
-                    // The movement of each object is based on inverse mass, so total that
-                    float totalRadius = first.BoundingRadius() + second.BoundingRadius();
-                    
-                    Vector3 move = contact.ContactNormal * contact.Penetration;
-                    
-                    Vector3 moveFst = move * (-first.BoundingRadius() / totalRadius);
-                    Vector3 moveSec = move * (second.BoundingRadius() / totalRadius);
-                    
-                    first.SetPosition( first.Position() - moveFst );
-                    second.SetPosition( second.Position() - moveSec );
-                }
-            }
+            first.SetPosition( first.Position() - moveFst );
+            second.SetPosition( second.Position() - moveSec );
         }
     }
 }
@@ -11,6 +11,7 @@
 #include "EntityContainer.h"
 #include "Entity3D.h"
 #include "Contact.h"
+#include "SpatialHash3D.h"
 #include "Light3D.h"
 #include "Camera3D.h"
 #include "Renderer3D.h"
@@ -54,12 +55,22 @@ namespace Furiosity
         /// Updates the entities and handles collisions
         void virtual Update(float dt) override;
         
+        /// Removes all the entities and empties the broadphase
+        virtual void Clear() override;
+        
         /// This function must be overriden be each game
         virtual void HandleCollision(Contact3D& contact) = 0;
         
         /// Sets the currently active camera
         void SetActiveCamera(Camera3D* camera);
         
+        /// Sets the size of the broadphase cells. By default it gets picked
+        /// from the entities on the first update.
+        void SetCollisionCellSize(float size) { broadphase.SetCellSize(size); }
+        
+        /// Number of contacts found in the last update
+        int ContactCount() const { return (int)contacts.size(); }
+        
 #ifdef DEBUG
         /// DebugDraws all the entities in the world
         virtual void DebugDraw();
@@ -69,6 +80,19 @@ namespace Furiosity
         
         RenderManager3D renderInfo;
         
+        /// Keeps the colliders between updates, so only the ones that moved
+        /// to another cell cost anything
+        SpatialHash3D           broadphase;
+        
+        /// Contacts of the last update, reused
+        std::vector<Contact3D>  contacts;
+        
+        /// Finds all the contacts before any of them gets handled
+        void AccumulateContacts();
+        
+        /// Raises the events and pushes apart what wasn't resolved
+        void ResolveContacts();
+        
         virtual void PrepareToRender();
         
         virtual void RenderPass();
@@ -15,7 +15,13 @@ using namespace Furiosity;
 // Ctor 
 ////////////////////////////////////////////////////////////////////////////////
 DynamicEntity2D::DynamicEntity2D()
-: Entity2D() {}
+:   Entity2D(),
+    sweepThreshold(0.0f),
+    sleepTime(0.0f),
+    islandNext(0),
+    islandIndex(-1),
+    sleepingAllowed(true),
+    wakeIsland(false) {}
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -28,7 +34,14 @@ DynamicEntity2D::DynamicEntity2D(const Vector2& position, float radius, float ma
     maxForce(maxForce),
     maxTurnRate(maxTurnRate),
     velocity(0.0f, 0.0f),
-    linearDamping(0.998f)
+    linearDamping(0.998f),
+    lastPosition(position),
+    sweepThreshold(0.0f),
+    sleepTime(0.0f),
+    islandNext(0),
+    islandIndex(-1),
+    sleepingAllowed(true),
+    wakeIsland(false)
 {
     inverseMass = 1 / mass;
 }
@@ -48,7 +61,14 @@ DynamicEntity2D::DynamicEntity2D(const Vector2& position,
     maxForce(maxForce),
     maxTurnRate(maxTurnRate),
     velocity(0.0f, 0.0f),
-    linearDamping(0.998f)
+    linearDamping(0.998f),
+    lastPosition(position),
+    sweepThreshold(0.0f),
+    sleepTime(0.0f),
+    islandNext(0),
+    islandIndex(-1),
+    sleepingAllowed(true),
+    wakeIsland(false)
 {
     inverseMass = 1 / mass;
 }
@@ -65,8 +85,16 @@ DynamicEntity2D::DynamicEntity2D(const XMLElement* settings)
     linearDamping(0.98f),
     maxTurnRate(Pi),
     maxForce(MAXFLOAT),
-    maxSpeed(MAXFLOAT)
+    maxSpeed(MAXFLOAT),
+    sweepThreshold(0.0f),
+    sleepTime(0.0f),
+    islandNext(0),
+    islandIndex(-1),
+    sleepingAllowed(true),
+    wakeIsland(false)
 {
+    lastPosition = transform.Translation();
+    
     // Max force
     const char* pMaxForce = settings->Attribute("maxForce");
     if(pMaxForce) maxForce = atof(pMaxForce);
@@ -78,6 +106,80 @@ DynamicEntity2D::DynamicEntity2D(const XMLElement* settings)
     // Max turn rate
     const char* pMaxTurnRate = settings->Attribute("maxTurnRate");
     if(pMaxTurnRate) maxTurnRate = atof(pMaxTurnRate);
+    
+    // Sweep threshold
+    const char* pSweepThreshold = settings->Attribute("sweepThreshold");
+    if(pSweepThreshold) sweepThreshold = atof(pSweepThreshold);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Wake
+////////////////////////////////////////////////////////////////////////////////
+void DynamicEntity2D::Wake()
+{
+    if(!sleeping && !wakeIsland)
+        return;
+    
+    // The others might be updating on other threads, leave them to Commit
+    if(IsSimulating())
+    {
+        sleeping    = false;
+        sleepTime   = 0.0f;
+        wakeIsland  = true;
+        return;
+    }
+    wakeIsland = false;
+    
+    // Go around the ring
+    DynamicEntity2D* body = this;
+    do
+    {
+        DynamicEntity2D* next = body->islandNext;
+        body->sleeping      = false;
+        body->sleepTime     = 0.0f;
+        body->islandNext    = 0;
+        body = next;
+    }
+    while(body && body != this);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Commit
+////////////////////////////////////////////////////////////////////////////////
+void DynamicEntity2D::Commit()
+{
+    if(wakeIsland)
+        Wake();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Reset
+////////////////////////////////////////////////////////////////////////////////
+void DynamicEntity2D::Reset()
+{
+    // Same as the dtor, nothing in the island may point here
+    Wake();
+    Entity2D::Reset();
+    
+    velocity.Clear();
+    force.Clear();
+    sleepTime   = 0.0f;
+    islandNext  = 0;
+    islandIndex = -1;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// SetSleepingAllowed
+////////////////////////////////////////////////////////////////////////////////
+void DynamicEntity2D::SetSleepingAllowed(bool allowed)
+{
+    sleepingAllowed = allowed;
+    if(!allowed)
+        Wake();
 }
 
 
@@ -86,6 +188,17 @@ DynamicEntity2D::DynamicEntity2D(const XMLElement* settings)
 ////////////////////////////////////////////////////////////////////////////////
 void DynamicEntity2D::Update(float dt)
 {
+    // Remember where we started, for swept collisions
+    lastPosition = transform.Translation();
+    
+    // Asleep until something pushes it
+    if(sleeping)
+    {
+        if(force.SquareMagnitude() == 0.0f)
+            return;
+        Wake();
+    }
+    
     // Trim max force
     force.Trim(maxForce);
     
@@ -36,6 +36,31 @@ namespace Furiosity
         /// Force accumulator
         Vector2 force;
         
+        /// Where the entity was at the start of the last update
+        Vector2 lastPosition;
+        
+        /// Above this speed the collision manager sweeps the entity from its
+        /// last position, so it can't tunnel. Zero turns it off.
+        float sweepThreshold;
+        
+        /// Time spent moving slower than the sleep velocity
+        float sleepTime;
+        
+        /// Next body in the ring of a sleeping island, null while awake
+        DynamicEntity2D* islandNext;
+        
+        /// Used by the collision manager while building the islands
+        int islandIndex;
+        
+        /// Can the entity be put to sleep
+        bool sleepingAllowed;
+        
+        /// Woken in the simulate phase, the rest of the island wakes in Commit
+        bool wakeIsland;
+        
+        /// Takes care of the sleeping
+        friend class CollisionManager;
+        
     public:
         
         /// Creates an empty DynamicEntity2D, maybe a streaming solution, NOT
@@ -64,19 +89,26 @@ namespace Furiosity
         /// streaming at the same time.
         DynamicEntity2D(const XMLElement* settings);
                  
-        /// No dynamic memory or pointers to care about
-        virtual ~DynamicEntity2D() { }
+        /// Wakes the island, so no sleeping body is left pointing here
+        virtual ~DynamicEntity2D() { Wake(); }
         
         /// Move it
         virtual void    Update(float dt);
         
+        /// Wakes the rest of the island if it was woken in the simulate
+        /// phase. Call it when overriding.
+        virtual void    Commit();
+        
+        /// Wakes the island and stops the entity
+        virtual void    Reset();
+        
 #ifdef DEBUG        
 		virtual void	DebugRender(Color c = Color::Red);
 #endif	
         
         /// Velocity
         Vector2  Velocity() const                       { return velocity;  }
-        void     SetVelocity(const Vector2& vel)        { velocity = vel;   }        
+        void     SetVelocity(const Vector2& vel)        { velocity = vel; Wake(); }
         float    Speed() const                          { return velocity.Magnitude(); }
         
         /// Read only property
@@ -102,6 +134,23 @@ namespace Furiosity
         void    SetMaxTurnRate(float rate)      { maxTurnRate = rate;   }
         
         /// Add force to the accumulator
-        void    AddForce(const Vector2& f)      { force += f; }
+        void    AddForce(const Vector2& f)
+        { force += f; if(f.SquareMagnitude() > 0.0f) Wake(); }
+        
+        /// Position at the start of the last update
+        Vector2 LastPosition() const            { return lastPosition; }
+        
+        /// Speed above which the entity gets swept for collisions, zero is off
+        float   SweepThreshold() const          { return sweepThreshold;    }
+        void    SetSweepThreshold(float speed)  { sweepThreshold = speed;   }
+        
+        /// Wakes up the entity and all the others in its island. From the
+        /// simulate phase only the entity wakes, the others in Commit.
+        void    Wake();
+        
+        /// A sleeping entity still gets its Update, only the integration is
+        /// skipped until a force or a velocity wakes it up
+        bool    SleepingAllowed() const         { return sleepingAllowed;   }
+        void    SetSleepingAllowed(bool allowed);
     };
 }
@@ -6,6 +6,7 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include <cassert>
+#include <new>
 
 #include "Entity2D.h"
 #include "DebugDraw2D.h"
@@ -17,12 +18,14 @@ using namespace Furiosity;
 // Default ctor
 ////////////////////////////////////////////////////////////////////////////////
 Entity2D::Entity2D()  :
+    Transformable(transform),
     inverseMass(0.0f),
-    Transformable(transform)
+    collisionLayer(0),
+    sleeping(false)
 {
     transform.SetIdentity();
     //
-    collisionShape = new CollisionNone(&transform);
+    CreateInlineShape(0.0f);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -30,12 +33,14 @@ Entity2D::Entity2D()  :
 ////////////////////////////////////////////////////////////////////////////////
 Entity2D::Entity2D(uint ID) :
     Entity(ID),
-    Transformable(transform)
+    Transformable(transform),
+    collisionLayer(0),
+    sleeping(false)
 {
     //    SetID(ID);
     transform.SetIdentity();
     // Always last
-    collisionShape = new CollisionNone(&transform);
+    CreateInlineShape(0.0f);
 }
 
 
@@ -44,17 +49,16 @@ Entity2D::Entity2D(uint ID) :
 ////////////////////////////////////////////////////////////////////////////////
 Entity2D::Entity2D(const Vector2& pos, float radius)  :
 //    Entity(nextValidID),
+    Transformable(transform),
     inverseMass(0.0f),
-    Transformable(transform)
+    collisionLayer(0),
+    sleeping(false)
 {
     transform.SetIdentity();
     transform.SetTranslation(pos);
     //
     // Always last
-    if(radius > 0)
-        collisionShape = new Disk(&transform, radius);
-    else
-        collisionShape = new CollisionNone(&transform);
+    CreateInlineShape(radius);
 }
 
 
@@ -62,8 +66,10 @@ Entity2D::Entity2D(const Vector2& pos, float radius)  :
 // Ctor from an explicit collision shape
 ////////////////////////////////////////////////////////////////////////////////
 Entity2D::Entity2D(const Vector2& pos, CollisionShape* chape) :
+    Transformable(transform),
     inverseMass(0.0f),
-    Transformable(transform)
+    collisionLayer(0),
+    sleeping(false)
 {
     transform.SetIdentity();
     transform.SetTranslation(pos);
@@ -81,7 +87,9 @@ Entity2D::Entity2D(const Vector2& pos, CollisionShape* chape) :
 ////////////////////////////////////////////////////////////////////////////////
 Entity2D::Entity2D(const XMLElement* settings) :
     Entity(settings),
-    Transformable(transform)
+    Transformable(transform),
+    collisionLayer(0),
+    sleeping(false)
 {
     //                      Transform
     // Init transformation
@@ -111,10 +119,11 @@ Entity2D::Entity2D(const XMLElement* settings) :
     //
     if(collisionEl)
         collisionShape = CollisionShape::Create(&transform, collisionEl);
-    else if(pRadius)
-        collisionShape = new Disk(&transform, atof(pRadius));
-    else        
-        collisionShape = new CollisionNone(&transform);
+    else
+        CreateInlineShape(pRadius ? atof(pRadius) : 0.0f);
+    //
+    const char* pCollisionLayer = settings->Attribute("collisionLayer");
+    if(pCollisionLayer) collisionLayer = atoi(pCollisionLayer);
     
     /*
     //                      Render Layer
@@ -127,6 +136,32 @@ Entity2D::Entity2D(const XMLElement* settings) :
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+// Dtor
+////////////////////////////////////////////////////////////////////////////////
+Entity2D::~Entity2D()
+{
+    if(HasInlineShape())
+        collisionShape->~CollisionShape();
+    else
+        delete collisionShape;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CreateInlineShape
+////////////////////////////////////////////////////////////////////////////////
+void Entity2D::CreateInlineShape(float radius)
+{
+    static_assert(sizeof(CollisionNone) <= sizeof(Disk), "Shape storage is too small");
+    
+    if(radius > 0)
+        collisionShape = new (&shapeStorage) Disk(&transform, radius);
+    else
+        collisionShape = new (&shapeStorage) CollisionNone(&transform);
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // BoundingRadius
 ////////////////////////////////////////////////////////////////////////////////
@@ -139,6 +174,41 @@ float Entity2D::BoundingRadius() const
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+// InterpolatedTransform
+////////////////////////////////////////////////////////////////////////////////
+Matrix33 Entity2D::InterpolatedTransform(float alpha) const
+{
+    // Blending the elements would shrink and shear the basis while it turns,
+    // so the old basis gets turned part of the way instead
+    Vector2 from    = previousTransform.Right();
+    Vector2 to      = transform.Right();
+    float angle     = atan2f(from.x * to.y - from.y * to.x, from.DotProduct(to)) * alpha;
+    float c         = cosf(angle);
+    float s         = sinf(angle);
+    
+    Vector2 right   = previousTransform.Right();
+    Vector2 up      = previousTransform.Up();
+    right           = Vector2(c * right.x - s * right.y, s * right.x + c * right.y);
+    up              = Vector2(c * up.x - s * up.y, s * up.x + c * up.y);
+    
+    // Only the lengths get blended, in case there is some scaling
+    float rightFrom = previousTransform.Right().Magnitude();
+    float upFrom    = previousTransform.Up().Magnitude();
+    if(rightFrom > 0.0f)
+        right *= (rightFrom + (to.Magnitude() - rightFrom) * alpha) / rightFrom;
+    if(upFrom > 0.0f)
+        up *= (upFrom + (transform.Up().Magnitude() - upFrom) * alpha) / upFrom;
+    
+    Vector2 translation = previousTransform.Translation() +
+                          (transform.Translation() - previousTransform.Translation()) * alpha;
+    
+    Matrix33 result;
+    result.SetTransform(up, right, translation);
+    return result;
+}
+
+
 #ifdef DEBUG
 ////////////////////////////////////////////////////////////////////////////////
 // Debug Render
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <string>
+#include <type_traits>
 
 // Local includes
 #include "Frmath.h"
@@ -38,6 +39,10 @@ namespace Furiosity
 		      
 		/// Position and orientation in the envirnoment
         Matrix33    transform;
+        
+        /// The transform at the start of the last fixed step, for rendering
+        /// in between steps
+        Matrix33    previousTransform;
 		
         /// Like mass, but then inverse
         float       inverseMass;
@@ -47,6 +52,17 @@ namespace Furiosity
 		
 		/// Geometry used for collision checking        
         CollisionShape* collisionShape;
+        
+        /// Disks and empty shapes are made in here, so they live in the same
+        /// allocation as the entity. Other shapes go on the heap.
+        std::aligned_storage<sizeof(Disk), std::alignment_of<Disk>::value>::type
+                        shapeStorage;
+        
+        /// Collision layer, from 0 to 31
+        uint            collisionLayer;
+        
+        /// Set while the physics has put the entity to sleep
+        bool            sleeping;
 		
 		/// Create with ID
 		Entity2D(uint ID);
@@ -67,11 +83,14 @@ namespace Furiosity
         Entity2D(const XMLElement* settings);
 				
         /// Simple dtor
-		virtual			~Entity2D() { delete collisionShape; }
+		virtual			~Entity2D();
 		
         /// Place your logic inside (if any) 
 		virtual void	Update(float dt) {}
         
+        /// Wakes it up, call this from overrides
+        virtual void    Reset()                         { sleeping = false; }
+        
         /// This is up to the 
         virtual void    HandleMessage(const Message& message) {}
 		
@@ -90,6 +109,27 @@ namespace Furiosity
         
         /// Gets the collision shape
         CollisionShape* GetCollisionShape() const       { return collisionShape; }
+        
+        /// Collision layer, the collision manager decides which layers collide
+        uint            CollisionLayer() const          { return collisionLayer;        }
+        void            SetCollisionLayer(uint layer)   { collisionLayer = layer;       }
+        
+        /// A sleeping entity is not moved by the physics. The broadphase still
+        /// follows it when it's moved by hand, but it stays asleep until
+        /// something awake touches it, so wake it when moving it.
+        bool            IsSleeping() const              { return sleeping;              }
+        
+        /// Remembers the transform as it is, the world does this before
+        /// every fixed step
+        void            StoreTransform()                { previousTransform = transform; }
+        
+        /// The transform at the start of the last fixed step
+        const Matrix33& PreviousTransform() const       { return previousTransform;     }
+        
+        /// Blends from the previous transform to the current one, zero
+        /// gives the previous. The position is blended and the rotation
+        /// takes the short way around, so the basis stays rigid.
+        Matrix33        InterpolatedTransform(float alpha) const;
 
         
         /// Mass access methods
@@ -100,5 +140,13 @@ namespace Furiosity
         void            SetInverseMass(float m)         { inverseMass = m;              }
         //
         bool            HasInifitesMass()               { return inverseMass == 0.0f;   }
+        
+    protected:
+        /// Makes a disk in the shape storage, or an empty shape for no radius
+        void            CreateInlineShape(float radius);
+        
+        /// Checks if the shape lives in the shape storage
+        bool            HasInlineShape() const
+        { return (const void*)collisionShape == (const void*)&shapeStorage; }
     };
 }
\ No newline at end of file
@@ -9,13 +9,25 @@
 #include "Furiosity.h"
 
 #include <algorithm>
+#include <cassert>
 
 using namespace Furiosity;
 
 ////////////////////////////////////////////////////////////////////////////////
 // Make a new gameworld
 ////////////////////////////////////////////////////////////////////////////////
-GameWorld::GameWorld() : isRunning(true)
+GameWorld::GameWorld() :
+    wallsChanged(false),
+    isRunning(true),
+    broadphaseStale(true),
+    syncedBroadphase(0),
+    queryScratch(1),
+    fixedStep(1.0f / 60.0f),
+    maxSubsteps(4),
+    accumulator(0.0f),
+    interpolationAlpha(1.0f),
+    substeps(0),
+    droppedTime(0.0f)
 {
     manageCollisions = false;
     collisionManager = new CollisionManager(this, 300);
@@ -30,6 +42,15 @@ GameWorld::~GameWorld()
     delete collisionManager;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// SetJobSystem
+////////////////////////////////////////////////////////////////////////////////
+void GameWorld::SetJobSystem(JobSystem* jobSystem)
+{
+    EntityCollection<Entity2D>::SetJobSystem(jobSystem);
+    collisionManager->SetJobSystem(jobSystem);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Queues adding an entity
 ////////////////////////////////////////////////////////////////////////////////
@@ -43,12 +64,7 @@ void GameWorld::AddEntity(Entity2D* e)
 ////////////////////////////////////////////////////////////////////////////////
 void GameWorld::RemoveEntity(Entity2D* e)
 {
-    // No double removes
-    for (auto bge : removeQueue)
-        if(bge == e)
-            return;
-    //
-    removeQueue.insert(e);
+    QueueRemoval(e);
     
     // Let the other entities know
     // EntityDeletedMessage msg(*e);
@@ -60,9 +76,14 @@ void GameWorld::RemoveEntity(Entity2D* e)
 ////////////////////////////////////////////////////////////////////////////////
 Entity2D* GameWorld::SelectClosestEntity(const Vector2& position)
 {
+    SyncBroadphase();
+    
+    std::vector<Entity2D*>& candidates = Scratch().candidates;
+    CollectCandidates(AABB(position, position), candidates);
+    
 	float mindist = MAXFLOAT;
 	Entity2D* closest = NULL;
-    for (auto bge : entities)
+    for (auto bge : candidates)
 	{
 		float dist = (bge->Position() - position).Magnitude();
 		if (dist < bge->BoundingRadius() && dist < mindist)
@@ -80,40 +101,256 @@ Entity2D* GameWorld::SelectClosestEntity(const Vector2& position)
 ////////////////////////////////////////////////////////////////////////////////
 Entity2D* GameWorld::SelectClosestEntityOfType(const Vector2& position, int type)
 {
-	float mindist = MAXFLOAT;
+    float mindist = MAXFLOAT;
 	Entity2D* closest = NULL;
-	
-    for(auto bge : entities)
+    for (auto bge : index.OfType(type))
 	{
-		float dist = (bge->Position() - position).Magnitude();
-		if (bge->EntityType() == type /* && dist < bge->BoundingRadius() */ && dist < mindist)
+		float dist = (bge->Position() - position).SquareMagnitude();
+		if (dist < mindist)
 		{
 			mindist = dist;
 			closest = bge;
 		}
 	}
-	
+    
 	return closest;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// SelectEntitiesWithFlags
+////////////////////////////////////////////////////////////////////////////////
+int GameWorld::SelectEntitiesWithFlags(int flags, std::vector<Entity2D*>& result) const
+{
+    result.clear();
+    index.VisitFlags(flags, [&result](Entity2D* bge)
+    {
+        result.push_back(bge);
+    });
+    
+    return (int)result.size();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // TagEntitiesWithinRange
 ////////////////////////////////////////////////////////////////////////////////
 void GameWorld::TagEntitiesWithinRange(Entity2D*entity, float range)
 {
-    for(auto bge : entities)
-	{
+    // Clear the last tags, no need to walk all the entities for that
+    for(auto& handle : taggedHandles)
+        if(Entity2D* bge = GetEntity(handle))
+            bge->UnTag();
+    
+    QueryRange(entity->Position(), range, tagged, [entity](const Entity2D* e)
+    {
         // Skip self
-        if(entity == bge)
-            continue;
+        return e != entity;
+    });
+    
+    taggedHandles.clear();
+    for(auto bge : tagged)
+    {
+        bge->Tag();
+        taggedHandles.push_back(bge->Handle());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// GetEntitiesWithinRange
+////////////////////////////////////////////////////////////////////////////////
+vector<Entity2D*> GameWorld::GetEntitiesWithinRange(Entity2D* entity, float range)
+{
+    vector<Entity2D*> result;
+    QueryRange(entity->Position(), range, result, [entity](const Entity2D* e)
+    {
+        return e != entity;
+    });
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// QueryRange
+////////////////////////////////////////////////////////////////////////////////
+int GameWorld::QueryRange(const Vector2& center,
+                          float range,
+                          std::vector<Entity2D*>& result,
+                          const EntityFilter& filter)
+{
+    SyncBroadphase();
+    
+    result.clear();
+    std::vector<Entity2D*>& candidates = Scratch().candidates;
+    CollectCandidates(AABB::FromDisk(center, range), candidates);
+    
+    float rangeSq = range * range;
+    for(auto bge : candidates)
+    {
+        if((bge->Position() - center).SquareMagnitude() < rangeSq &&
+           (!filter || filter(bge)))
+            result.push_back(bge);
+    }
+    
+    return (int)result.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// QueryBox
+////////////////////////////////////////////////////////////////////////////////
+int GameWorld::QueryBox(const AABB& box,
+                        std::vector<Entity2D*>& result,
+                        const EntityFilter& filter)
+{
+    SyncBroadphase();
+    
+    result.clear();
+    std::vector<Entity2D*>& candidates = Scratch().candidates;
+    CollectCandidates(box, candidates);
+    
+    for(auto bge : candidates)
+        if(!filter || filter(bge))
+            result.push_back(bge);
+    
+    return (int)result.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// QueryNearest
+////////////////////////////////////////////////////////////////////////////////
+int GameWorld::QueryNearest(const Vector2& position,
+                            int k,
+                            std::vector<Entity2D*>& result,
+                            float maxRange,
+                            const EntityFilter& filter)
+{
+    SyncBroadphase();
+    
+    result.clear();
+    if(k <= 0)
+        return 0;
+    
+    const Broadphase* broadphase = collisionManager->GetBroadphase();
+    int total = (int)(broadphase->Bodies().size() + broadphase->Skipped().size());
+    
+    QueryScratch& scratch = Scratch();
+    std::vector<std::pair<float, Entity2D*>>& nearest = scratch.nearest;
+    
+    // Grow the search box until it has enough entities in range, or until
+    // it has seen them all
+    float radius = std::min(scratch.nearestRadius, maxRange);
+    for(;;)
+    {
+        CollectCandidates(AABB::FromDisk(position, radius), scratch.candidates);
         
-        // Clear all tags
-        bge->UnTag();
-        //
-		float dist = (bge->Position() - entity->Position()).Magnitude();;
-		if (dist < range)
-            bge->Tag();
-	}
+        // Outside the disk, there might be closer ones just outside the box
+        bool all        = (int)scratch.candidates.size() == total;
+        float limit     = all ? maxRange : radius;
+        float limitSq   = limit * limit;
+        
+        nearest.clear();
+        for(auto bge : scratch.candidates)
+        {
+            float distSq = (bge->Position() - position).SquareMagnitude();
+            if(distSq <= limitSq && (!filter || filter(bge)))
+                nearest.push_back(std::make_pair(distSq, bge));
+        }
+        
+        if((int)nearest.size() >= k || all || radius >= maxRange)
+            break;
+        
+        radius = std::min(radius * 2.0f, maxRange);
+    }
+    
+    // Next time start a bit closer
+    scratch.nearestRadius = std::max(radius * 0.5f, 1.0f);
+    
+    int count = std::min(k, (int)nearest.size());
+    std::partial_sort(nearest.begin(),
+                      nearest.begin() + count,
+                      nearest.end(),
+                      [](const std::pair<float, Entity2D*>& a,
+                         const std::pair<float, Entity2D*>& b)
+                      {
+                          return a.first < b.first;
+                      });
+    
+    for(int i = 0; i < count; i++)
+        result.push_back(nearest[i].second);
+    
+    return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// RayCastEntities
+////////////////////////////////////////////////////////////////////////////////
+Entity2D* GameWorld::RayCastEntities(const Vector2& from,
+                                     const Vector2& to,
+                                     float* fraction,
+                                     const EntityFilter& filter)
+{
+    SyncBroadphase();
+    
+    std::vector<Entity2D*>& candidates = Scratch().candidates;
+    CollectCandidates(AABB::FromSegment(from, to), candidates);
+    
+    // A ray is a disk with no radius
+    float best = 1.0f;
+    Entity2D* hit = NULL;
+    for(auto bge : candidates)
+    {
+        float t;
+        if(SweepDiskToDisk(from, to, 0.0f, bge->Position(), bge->BoundingRadius(), t) &&
+           t <= best &&
+           (!filter || filter(bge)))
+        {
+            best = t;
+            hit = bge;
+        }
+    }
+    
+    if(hit && fraction)
+        *fraction = best;
+    return hit;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SyncBroadphase
+////////////////////////////////////////////////////////////////////////////////
+void GameWorld::SyncBroadphase()
+{
+    const Broadphase* broadphase = collisionManager->GetBroadphase();
+    if(broadphaseStale || broadphase != syncedBroadphase)
+    {
+        collisionManager->GetBroadphase()->Update(entities.Items());
+        syncedBroadphase = broadphase;
+        broadphaseStale = false;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Scratch
+////////////////////////////////////////////////////////////////////////////////
+GameWorld::QueryScratch& GameWorld::Scratch()
+{
+    // Workers only get here from the simulate phase, sized right before it
+    int thread = jobs ? jobs->ThreadIndex() : 0;
+    assert(thread < (int)queryScratch.size());
+    return queryScratch[thread];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// CollectCandidates
+////////////////////////////////////////////////////////////////////////////////
+void GameWorld::CollectCandidates(const AABB& box,
+                                  std::vector<Entity2D*>& candidates) const
+{
+    const Broadphase* broadphase = collisionManager->GetBroadphase();
+    
+    candidates.clear();
+    broadphase->Query(box, candidates);
+    
+    // Usually only a few of these
+    for(auto bge : broadphase->Skipped())
+        if(EntityBounds(bge).Overlaps(box))
+            candidates.push_back(bge);
 }
 
 /*
@@ -142,27 +379,20 @@ void GameWorld::TagEntitiesWithinRange(Entity2D *entity, float range)
 */      
 
 ////////////////////////////////////////////////////////////////////////////////
-// GetEntityByID
+// GetEntity
 ////////////////////////////////////////////////////////////////////////////////
-Entity2D* GameWorld::GetEntityByID(int id)
+Entity2D* GameWorld::GetEntity(const EntityHandle& handle)
 {
-    for(auto bge : entities)
-		if (bge->GetID() == id)
-            return bge;
-    
-    return 0;
+    Entity2D** bge = entities.Find(handle);
+    return bge ? *bge : 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// GetEntityByName
+// GetEntityByID
 ////////////////////////////////////////////////////////////////////////////////
-Entity2D* GameWorld::GetEntityByName(string name)
+Entity2D* GameWorld::GetEntityByID(int id)
 {
-    for (auto bge : entities)
-		if (bge->Name().compare(name) == 0)
-            return bge;
-    
-    return 0;
+    return index.FindByID(id);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -173,44 +403,137 @@ void GameWorld::Update(float dt)
     if(!isRunning)
         return;
     
-    // Add entities
+    // Add entities, they start blending from where they were added
     for (auto bge : addQueue)
-        entities.push_back(bge);
+        bge->StoreTransform();
+    AddQueued();
     
-    addQueue.clear();
+    // Queries from the worker threads only read the broadphase, so it has to
+    // be up to date before they start
+    if(UpdatesInParallel())
+    {
+        if((int)queryScratch.size() < GetWorkerCount())
+            queryScratch.resize(GetWorkerCount());
+        SyncBroadphase();
+    }
         
-    // Update entites
-    for (auto bge : entities)
-		bge->Update(dt);
+    // Update entites, sleeping ones don't move
+    UpdateEntities(dt);
+    
+    // Things have moved
+    broadphaseStale = true;
     
     if(manageCollisions)
     {
+        SyncWalls();
         collisionManager->Clear();
-        collisionManager->AccumulateContacts(entities);
-        collisionManager->AccumulateContacts(entities, walls);
+        collisionManager->AccumulateContacts(entities.Items());
+        collisionManager->AccumulateContacts(entities.Items(), walls);
         collisionManager->RaiseContactEvents();
         collisionManager->ResolveContacts();
         collisionManager->ResolveVelocity();
+        collisionManager->UpdateIslands(entities.Items(), dt);
     }
     
+    // Messages go out while the receivers are all still there
+    messages.Dispatch(dt);
+    
     // Remove after update so that no new entities have been added entites
-    for(auto bge : removeQueue)
+    RemoveQueued();
+    
+    // The solver moved things too
+    broadphaseStale = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Step
+////////////////////////////////////////////////////////////////////////////////
+int GameWorld::Step(float dt)
+{
+    substeps = 0;
+    if(!isRunning)
+        return 0;
+    
+    // Variable step, nothing to blend
+    if(fixedStep <= 0.0f)
     {
-        entities.remove(bge);           // Derefence j as it holds an pointer
-        SafeDelete(bge);                // THIS is not a solution!!
+        for (auto bge : entities)
+            bge->StoreTransform();
+        Update(dt);
+        interpolationAlpha = 1.0f;
+        substeps = 1;
+        return substeps;
     }
-    removeQueue.clear();
+    
+    accumulator += dt;
+    while(accumulator >= fixedStep && substeps < maxSubsteps)
+    {
+        for (auto bge : entities)
+            bge->StoreTransform();
+        Update(fixedStep);
+        accumulator -= fixedStep;
+        substeps++;
+    }
+    
+    // Out of substeps, keep only the part of a step
+    if(accumulator >= fixedStep)
+    {
+        float left = fmodf(accumulator, fixedStep);
+        droppedTime += accumulator - left;
+        accumulator = left;
+    }
+    
+    interpolationAlpha = accumulator / fixedStep;
+    return substeps;
 }
 
-void GameWorld::Clear()
+////////////////////////////////////////////////////////////////////////////////
+// SyncWalls
+////////////////////////////////////////////////////////////////////////////////
+void GameWorld::SyncWalls()
+{
+    if(wallsChanged)
+    {
+        collisionManager->SetWalls(walls);
+        wallsChanged = false;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// RayCastWalls
+////////////////////////////////////////////////////////////////////////////////
+bool GameWorld::RayCastWalls(const Vector2& from, const Vector2& to, Vector2* hit)
 {
-    for(auto bge : entities)
-		SafeDelete(bge);
+    SyncWalls();
     
-    entities.clear();
-    addQueue.clear();
-    removeQueue.clear();
+    float fraction;
+    int segment;
+    if(!collisionManager->GetWalls().RayCast(from, to, fraction, segment))
+        return false;
+    
+    if(hit)
+        *hit = from + (to - from) * fraction;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// LineOfSight
+////////////////////////////////////////////////////////////////////////////////
+bool GameWorld::LineOfSight(const Vector2& from, const Vector2& to)
+{
+    return !RayCastWalls(from, to);
+}
+
+void GameWorld::Clear()
+{
+    ClearEntities();
     walls.clear();
+    wallsChanged = true;
+    tagged.clear();
+    taggedHandles.clear();
+    broadphaseStale = true;
+    accumulator = 0.0f;
+    collisionManager->ClearContactCache();
 
     Entity2D::ResetNextValidID();
 }
@@ -232,8 +555,7 @@ void GameWorld::DebugRender()
 
 void GameWorld::BroadcastMessage(const Message& message) const
 {
-    for (auto bge : entities)
-		bge->HandleMessage(message);
+    messages.Send(message);
 }
 
 
@@ -9,8 +9,7 @@
 #define GAME_WORLD_H
 
 #include <vector>
-#include <list>
-#include <set>
+#include <functional>
 
 #include "Entity2D.h"
 #include "CollisionShapes.h"
@@ -18,6 +17,7 @@
 #include "Frmath.h"
 #include "Contact.h"
 #include "Messaging.h"
+#include "EntityCollection.h"
 
 namespace Furiosity
 {
@@ -27,28 +27,85 @@ namespace Furiosity
     /// The world also has a mechanism for handling collision and collision events.
     /// Games using the engine should inherit this class for their levels.
     ///
-    class GameWorld
+    class GameWorld : public EntityCollection<Entity2D>
 	{
 	public:
-        typedef std::list<Entity2D*>      EntityContainer;
+        typedef SlotMap<Entity2D*>        EntityContainer;
         
-        typedef std::set<Entity2D*>       EntityRemoveQueue;
+        typedef std::vector<Entity2D*>    EntityRemoveQueue;
 //        typedef EntityRemoveQueue::iterator     EntityRmQueueIterator;
         
-        // All the entities in this world
-        EntityContainer                 entities;
+        // Picks the entities a query should report, an empty one takes all
+        typedef std::function<bool(const Entity2D*)> EntityFilter;
         
-        // Queue so that adding can be done form the game loop itself
-		std::vector<Entity2D*>    addQueue;
-
-        // Queue so that removing can be done form the game loop itself
-        EntityRemoveQueue               removeQueue;
+        // The entities, their queues and index live in the collection, the
+        // world has always had them out in the open
+        using EntityCollection<Entity2D>::entities;
+        using EntityCollection<Entity2D>::addQueue;
+        using EntityCollection<Entity2D>::removeQueue;
+        using EntityCollection<Entity2D>::index;
+        using EntityCollection<Entity2D>::jobs;
+        using EntityCollection<Entity2D>::messages;
         
          // Level geometry
         std::vector<LineSegment>        walls;
         
+        // The walls need to be handed over to the collision manager again
+        bool                            wallsChanged;
+        
         // Ability to stop time in this world
         bool                            isRunning;
+        
+        // The entities might have moved since the broadphase was updated
+        bool                            broadphaseStale;
+        
+        // The broadphase that was updated last, it can get swapped
+        const Broadphase*               syncedBroadphase;
+        
+        // What a query needs on the side, reused
+        struct QueryScratch
+        {
+            // Candidates from the broadphase
+            std::vector<Entity2D*>                      candidates;
+            
+            // Entities and their squared distances, for the nearest queries
+            std::vector<std::pair<float, Entity2D*>>    nearest;
+            
+            // Nearest queries start searching from this radius
+            float                                       nearestRadius;
+            
+            QueryScratch() : nearestRadius(1.0f) {}
+        };
+        
+        // One scratch per thread, so thread safe entities can query the
+        // world from their update
+        std::vector<QueryScratch>       queryScratch;
+        
+        // Entities in range for TagEntitiesWithinRange, reused
+        std::vector<Entity2D*>          tagged;
+        
+        // The ones the last TagEntitiesWithinRange tagged, as handles since
+        // they might be gone by the next call
+        std::vector<EntityHandle>       taggedHandles;
+        
+        // Length of a fixed step, zero makes Step run one variable update
+        float                           fixedStep;
+        
+        // Most fixed steps taken in one call to Step
+        int                             maxSubsteps;
+        
+        // Time handed to Step that wasn't simulated yet
+        float                           accumulator;
+        
+        // How far along the next step the time is, from zero to one
+        float                           interpolationAlpha;
+        
+        // Fixed steps taken in the last call to Step
+        int                             substeps;
+        
+        // Time thrown away because of the substep cap
+        float                           droppedTime;
+        
     
     public:
         
@@ -63,30 +120,123 @@ namespace Furiosity
         // Dtor
 		virtual ~GameWorld();
 		
+        // The spatial queries below go through the broadphase of the collision
+        // manager. Entities that are not in it, with no collision shape or on a
+        // layer that doesn't collide, are checked one by one. The results are
+        // written to the given buffer, which is cleared first, and the count
+        // is returned.
+        
+        // Closest entity with its bounding disk over the position
 		Entity2D* SelectClosestEntity(const Vector2& position);
         
+        // Closest entity of the given type, at any distance. This one walks
+        // only the entities of the type, collision shape or not.
 		Entity2D* SelectClosestEntityOfType(const Vector2& position, int type);
         
+        // All entities of exactly this type, without walking the others
+        const std::vector<Entity2D*>& SelectEntitiesOfType(int type) const
+        { return index.OfType(type); }
+        
+        // Entities that have any of the type flags set
+        int SelectEntitiesWithFlags(int flags, std::vector<Entity2D*>& result) const;
+        
+        // Tags the entities within range of this one and untags the ones
+        // the last call tagged, tags set in other ways are left alone. Not
+        // from a thread safe update, it changes other entities.
         void TagEntitiesWithinRange(Entity2D* entity, float range);
         
         vector<Entity2D*> GetEntitiesWithinRange(Entity2D* entity, float range);
+        
+        // The queries can be used from the update of thread safe entities,
+        // the entities are where they were at the start of the update then
+        
+        // Entities with the center within range of a point
+        int QueryRange(const Vector2& center,
+                       float range,
+                       std::vector<Entity2D*>& result,
+                       const EntityFilter& filter = EntityFilter());
+        
+        // Entities with the bounding box overlapping the box
+        int QueryBox(const AABB& box,
+                     std::vector<Entity2D*>& result,
+                     const EntityFilter& filter = EntityFilter());
+        
+        // Up to k entities closest to the position, closest first
+        int QueryNearest(const Vector2& position,
+                         int k,
+                         std::vector<Entity2D*>& result,
+                         float maxRange = MAXFLOAT,
+                         const EntityFilter& filter = EntityFilter());
+        
+        // Finds the first bounding disk hit going from-to, ignoring the ones
+        // that contain the start. The fraction along the way is optional.
+        Entity2D* RayCastEntities(const Vector2& from,
+                                  const Vector2& to,
+                                  float* fraction = 0,
+                                  const EntityFilter& filter = EntityFilter());
 		
 		void AddEntity(Entity2D* e);
         
 		void RemoveEntity(Entity2D* e);
         
+        // The entity behind a handle, null if it's gone
+        Entity2D* GetEntity(const EntityHandle& handle);
+        
         Entity2D* GetEntityByID(int id);
         
-        Entity2D* GetEntityByName(string name);
+        // An entity with the name, names might not be unique
+        Entity2D* GetEntityByName(const std::string& name) { return index.FindByName(name); }
+        
+        // An entity with an interned name, see NameTable
+        Entity2D* GetEntityByName(NameID name) { return index.FindByName(name); }
         
         //
-        void AddWall(LineSegment wall) { walls.push_back(wall); }
+        void AddWall(LineSegment wall) { walls.push_back(wall); wallsChanged = true; }
+        
+        // Call after changing the walls directly
+        void WallsChanged() { wallsChanged = true; }
+        
+        // Finds the first wall hit going from-to, the hit point is optional
+        bool RayCastWalls(const Vector2& from, const Vector2& to, Vector2* hit = 0);
+        
+        // Checks if there are no walls between the two points
+        bool LineOfSight(const Vector2& from, const Vector2& to);
         //
-        const std::list<Entity2D*>& Entites() const { return entities; }
+        const std::vector<Entity2D*>& Entites() const { return entities.Items(); }
 		
         // Gameplay goes here
 		void virtual Update(float dt);
         
+        // Advances the world by the frame time in fixed steps, calling Update
+        // for each. Time left over is kept for the next call, anything above
+        // the substep cap is dropped so a slow frame can't snowball. Returns
+        // the number of steps taken.
+        int Step(float dt);
+        
+        // Sets the length of a fixed step, zero turns fixed stepping off
+        void SetFixedStep(float step)       { fixedStep = step; }
+        float GetFixedStep() const          { return fixedStep; }
+        
+        // Sets the most steps taken in one call to Step
+        void SetMaxSubsteps(int count)      { maxSubsteps = count; }
+        int GetMaxSubsteps() const          { return maxSubsteps; }
+        
+        // How far the time is between the last two steps, for blending the
+        // transforms when rendering. See Entity2D::InterpolatedTransform.
+        float InterpolationAlpha() const    { return interpolationAlpha; }
+        
+        // Fixed steps taken in the last call to Step
+        int SubstepCount() const            { return substeps; }
+        
+        // Time dropped because of the substep cap, in total
+        float DroppedTime() const           { return droppedTime; }
+        
+        // Sets the job system for the entity update and the collisions, null
+        // for the calling thread only (the default). With one, entities that
+        // are thread safe are updated in batches over its threads, then the
+        // rest on this thread.
+        void SetJobSystem(JobSystem* jobSystem);
+        
         CollisionManager* GetCollisionManager() const { return collisionManager; }
         
         // Gameplay goes here as well
@@ -107,7 +257,21 @@ namespace Furiosity
         
     protected:
         
-        void BroadcastMessage(const Message& message) const;        
+        // Sends the message right away to the entities subscribed to its type
+        void BroadcastMessage(const Message& message) const;
+        
+        // Rebuilds the wall hierarchy if needed
+        void SyncWalls();
+        
+        // Brings the broadphase up to date before a query
+        void SyncBroadphase();
+        
+        // Scratch of the calling thread
+        QueryScratch& Scratch();
+        
+        // Fills the candidates with the entities in the broadphase that
+        // overlap the box, plus the ones the broadphase doesn't hold
+        void CollectCandidates(const AABB& box, std::vector<Entity2D*>& candidates) const;
 	};
 }
 
@@ -11,6 +11,7 @@
 #include "Input.h"
 #include "GUI.h"
 #include "AudioManager.h"
+#include "JobSystem.h"
 
 using namespace Furiosity;
 
@@ -34,6 +35,9 @@ void GeneralManager::Initialize(const std::string &resourcesPath,
     this->screenHeight  = device.GetScreenHeight();
     this->fitToScreen   = fitToScreen;
     
+    // Workers first, one per processor
+    gJobSystem.Initialize();
+    
     // First init resource manager
     gResourceManager.Initialize(resourcesPath, localPath, remotePath);
     // Next is input
@@ -46,6 +50,9 @@ void GeneralManager::Initialize(const std::string &resourcesPath,
 
 void GeneralManager::Update(float dt)
 {
+    // Work the other threads left for this one
+    gJobSystem.ProcessMainThreadJobs();
+    
     // First init resource manager
     // gResourceManager.Update(dt);
     
@@ -72,6 +79,9 @@ void GeneralManager::Shutdown()
     
     // Next is GUI
     gGUIManager.Shutdown();
+    
+    // Workers go last, the others might still be using them
+    gJobSystem.Shutdown();
 }
 
 #ifdef IOS
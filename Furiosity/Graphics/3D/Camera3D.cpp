@@ -18,7 +18,7 @@ void Camera3D::UpdateViewMatrix()
 {
     //   if(dirty)
     //{
-        view = Matrix44(worldTrns);
+        view = Transform();
         view.Invert();
         dirty = false;
     //}
@@ -7,7 +7,29 @@
 
 
 // Platform specific OpenGL ES 2 includes for Android and iOS
-#ifdef ANDROID
+#if defined(FURIOSITY_HEADLESS)
+// No GL at all, just the types so that the headers compile. Good for tools
+// and benchmarks that only use the gameplay and collision code.
+#   include <cfloat>
+    typedef unsigned int    GLenum;
+    typedef unsigned int    GLuint;
+    typedef int             GLint;
+    typedef int             GLsizei;
+    typedef float           GLfloat;
+    typedef unsigned char   GLubyte;
+    typedef unsigned char   GLboolean;
+    typedef unsigned short  GLushort;
+    typedef short           GLshort;
+    typedef char            GLchar;
+    typedef void            GLvoid;
+    typedef unsigned int    GLbitfield;
+    typedef float           GLclampf;
+    typedef long            GLsizeiptr;
+    typedef long            GLintptr;
+#   ifndef MAXFLOAT
+#       define MAXFLOAT FLT_MAX
+#   endif
+#elif defined(ANDROID)
 #	include <EGL/egl.h>
 #	include <GLES2/gl2.h>
 #   include <GLES2/gl2ext.h>
@@ -2,6 +2,8 @@
 #include <sys/time.h>
 #include <cmath>
 #include <memory>
+#include <cstdarg>
+#include <cstring>
 
 #include "Utils.h"
 #include "Defines.h"